@@ -0,0 +1,157 @@
+//!
+//! @author M. Nickels
+//! @brief Benchmark of the library against the simulated bus and module
+//!
+//! @copyright Copyright (c) 2022
+//!
+//! This file is part of the Library "RREncoderI2C".
+//!
+//!      Creative Commons Attribution-ShareAlike 4.0 International License.
+//!
+//! To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/4.0/
+//! or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+//!
+//! Run with `pio run -e benchmark -t exec`. The results are printed as JSON to stdout,
+//! all values are averages per call:
+//!
+//! - transactions: i2c write and read transactions
+//! - bytes: bytes written and read
+//! - delay_us: time spent in delay() (simulated time)
+//! - cpu_ns: host CPU time
+//!
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <ctime>
+#include <functional>
+
+//! own includes
+#include "EncoderI2CSim.h"
+#include "rr_Encoder-i2c.h"
+
+//! calls per benchmark
+#define ITERATIONS 1000
+
+//! modules for the multi module benchmarks
+#define MODULES    4
+
+EncoderI2CSim modules[MODULES] = {{0x10}, {0x11}, {0x12}, {0x13}};
+EncoderI2C    encoders[MODULES];
+EncoderI2C&   encoder = encoders[0];
+
+//! separator between the JSON objects
+const char* separator = "";
+
+//!
+//! @brief run a benchmark and print the results
+//!
+//! @param name name of the benchmark
+//! @param iterations number of calls
+//! @param call the code to be measured
+//!
+void measure(const char* name, unsigned iterations, std::function<void(void)> call) {
+    for (EncoderI2CSim& module : modules) {
+        module.reset();
+    }
+
+    for (int loop = 0; loop < MODULES; loop++) {
+        encoders[loop] = EncoderI2C(ENCODER_I2C_ADDRESS + loop);
+
+        // the write sequence of the module starts from scratch
+        encoders[loop].reset();
+    }
+
+    Wire.resetStatistics();
+
+    unsigned long delayStart = nativeDelayMicros;
+    std::clock_t  cpuStart   = std::clock();
+
+    for (unsigned loop = 0; loop < iterations; loop++) {
+        call();
+    }
+
+    double              cpu   = (double)(std::clock() - cpuStart) / CLOCKS_PER_SEC * 1e9;
+    TwoWireStatistics_t stats = Wire.statistics();
+
+    printf("%s\n    {\"name\": \"%s\", \"iterations\": %u, \"transactions\": %.2f, \"bytes\": %.2f, "
+           "\"delay_us\": %.1f, \"cpu_ns\": %.1f, \"nacks\": %lu}",
+           separator, name, iterations, (double)stats.transactions / iterations,
+           (double)(stats.bytesWritten + stats.bytesRead) / iterations,
+           (double)(nativeDelayMicros - delayStart) / iterations, cpu / iterations, stats.nacks);
+
+    separator = ",";
+}
+
+//!
+//! @brief Main routine
+//!
+int main(int, char**) {
+    EncoderI2C*         pointers[MODULES];
+    EncoderI2CReading_t results[MODULES];
+
+    for (int loop = 0; loop < MODULES; loop++) {
+        Wire.attach(&modules[loop]);
+
+        pointers[loop] = &encoders[loop];
+    }
+
+    printf("{\n  \"benchmarks\": [");
+
+    // public methods
+    measure("position", ITERATIONS, []() { encoder.position(); });
+    measure("direction", ITERATIONS, []() { encoder.direction(); });
+    measure("button", ITERATIONS, []() { encoder.button(); });
+    measure("reading", ITERATIONS, []() { encoder.reading(); });
+    measure("version", ITERATIONS, []() { encoder.version(); });
+    measure("sequence", ITERATIONS, []() { encoder.sequence(); });
+    measure("setPosition", ITERATIONS, []() { encoder.setPosition(10); });
+    measure("setIncrement", ITERATIONS, []() { encoder.setIncrement(1); });
+    measure("setLowerLimit", ITERATIONS, []() { encoder.setLowerLimit(-100); });
+    measure("setUpperLimit", ITERATIONS, []() { encoder.setUpperLimit(100); });
+    measure("setConfig", ITERATIONS, []() {
+        EncoderI2Config_t config;
+
+        config.invertSwitch = true;
+        encoder.setConfig(config);
+    });
+    measure("setIncrement+waitForWrite", ITERATIONS, []() { encoder.waitForWrite(encoder.setIncrement(1)); });
+    measure("reset", ITERATIONS, []() { encoder.reset(); });
+
+    // typical loops
+    measure("loop (src/main.cpp)", ITERATIONS, []() {
+        encoder.position();
+        encoder.button();
+        encoder.direction();
+    });
+    measure("loop 4 modules", ITERATIONS, []() {
+        for (EncoderI2C& module : encoders) {
+            module.position();
+            module.button();
+            module.direction();
+        }
+    });
+    measure("pollAll 4 modules", ITERATIONS, [&]() { EncoderI2C::pollAll(pointers, MODULES, results); });
+
+    // chunked transfer
+    measure("readBulk 100 bytes", ITERATIONS, []() {
+        static byte block[100];
+        byte        data[sizeof(block)];
+        size_t      count;
+
+        modules[0].setBlock(block, sizeof(block));
+        encoder.readBulk(Bulk_User, data, sizeof(data), count);
+    });
+
+    // read cache, every call is served within the cache age
+    measure("loop cached", ITERATIONS, []() {
+        encoder.setCacheAge(100000);
+        encoder.invalidate();
+        encoder.position();
+        encoder.button();
+        encoder.direction();
+    });
+
+    printf("\n  ]\n}\n");
+
+    return 0;
+}
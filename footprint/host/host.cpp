@@ -0,0 +1,82 @@
+//!
+//! @author M. Nickels
+//! @brief Host sketch to report the footprint of the selected features
+//!
+//! @copyright Copyright (c) 2022
+//!
+//! This file is part of the Library "RREncoderI2C".
+//!
+//!      Creative Commons Attribution-ShareAlike 4.0 International License.
+//!
+//! To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/4.0/
+//! or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+//!
+
+#include <Arduino.h>
+#include <Wire.h>
+
+//! own includes
+#include "rr_Encoder-i2c.h"
+
+EncoderI2C encoder;
+
+//! keep the results, so the calls are not optimized away
+volatile EncoderI2CPosition_t result;
+
+//!
+//! @brief Setup routine, uses every selected feature once
+//!
+void setup() {
+    Wire.begin();
+
+#if ENCODER_I2C_FEATURE_VERSION
+    EncoderI2CVersion_t version;
+
+    encoder.version(version);
+    result = version[0];
+#endif
+
+#if ENCODER_I2C_FEATURE_CONFIG
+    EncoderI2Config_t config;
+
+    config.invertSwitch = true;
+    encoder.setConfig(config);
+#endif
+
+#if ENCODER_I2C_FEATURE_LIMITS
+    encoder.setLowerLimit(-100);
+    encoder.setUpperLimit(100);
+#endif
+
+#if ENCODER_I2C_FEATURE_WATCH
+    encoder.setWatch(0, -10, 10);
+    result = encoder.readWatchFlags();
+#endif
+
+    encoder.setIncrement(1);
+    encoder.waitForWrite(encoder.setPosition(0));
+
+    encoder.setCacheAge(10000);
+    result = encoder.refresh().position;
+
+#if ENCODER_I2C_FEATURE_BULK
+    byte   block[64];
+    size_t count;
+
+    encoder.readBulk(Bulk_Version, block, sizeof(block), count);
+    result = count;
+#endif
+}
+
+//!
+//! @brief Main loop
+//!
+void loop() {
+    result = encoder.position() + encoder.direction() + encoder.button();
+
+    EncoderI2CError_t error;
+
+    if (EncoderI2CErrors.pop(error)) {
+        result = error.kind;
+    }
+}
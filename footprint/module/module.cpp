@@ -0,0 +1,120 @@
+//!
+//! @author M. Nickels
+//! @brief Module sketch to report the footprint of the selected features
+//!
+//! @copyright Copyright (c) 2022
+//!
+//! This file is part of the Library "RREncoderI2C".
+//!
+//!      Creative Commons Attribution-ShareAlike 4.0 International License.
+//!
+//! To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/4.0/
+//! or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+//!
+//! Only the protocol is implemented, the encoder itself is left out
+//!
+
+#include <Arduino.h>
+#include <Wire.h>
+
+//! own includes
+#include "rr_Encoder-i2c-module.h"
+
+//!
+//! @brief the module functions called by EncoderI2CDispatcher
+//!
+class Module {
+  public:
+    EncoderI2CPosition_t position(void) {
+        return value;
+    }
+
+    EncoderI2CDirection_t direction(void) {
+        return None;
+    }
+
+    boolean button(void) {
+        return digitalRead(4) == LOW;
+    }
+
+    void version(EncoderI2CVersion_t version) {
+        strncpy(version, "footprint", sizeof(EncoderI2CVersion_t));
+    }
+
+    void setPosition(EncoderI2CPosition_t position) {
+        value = position;
+    }
+
+    void setIncrement(EncoderI2CPosition_t increment) {
+        value = increment;
+    }
+
+    void setLowerLimit(EncoderI2CPosition_t limit) {
+        value = limit;
+    }
+
+    void setUpperLimit(EncoderI2CPosition_t limit) {
+        value = limit;
+    }
+
+    void setAddress(byte address) {
+        newAddress = address;
+    }
+
+    void setConfig(EncoderI2Config_t config) {
+        value = config.invertSwitch;
+    }
+
+#if ENCODER_I2C_FEATURE_WATCH
+    void setWatch(const EncoderI2CWatch_t& watch) {
+        windows.set(watch, value);
+    }
+
+    EncoderI2CWatchFlags_t watchFlags(void) {
+        return windows.read();
+    }
+
+    EncoderI2CWatchWindows windows;
+#endif
+
+#if ENCODER_I2C_FEATURE_BULK
+    byte bulk(byte block, uint16_t offset, byte* data, byte length, boolean& end) {
+        static const char text[] = "footprint";
+
+        return copyChunk((const byte*)text, sizeof(text), offset, data, length, end);
+    }
+#endif
+
+    void reset(void) {
+        value = 0;
+    }
+
+    volatile EncoderI2CPosition_t value;
+    volatile byte                 newAddress;
+};
+
+Module                       module;
+EncoderI2CDispatcher<Module> dispatcher(module);
+
+//!
+//! @brief Setup routine
+//!
+void setup() {
+    Wire.begin(ENCODER_I2C_ADDRESS);
+    Wire.onReceive([](int count) { dispatcher.onReceive(count); });
+    Wire.onRequest([]() { dispatcher.onRequest(); });
+}
+
+//!
+//! @brief Main loop
+//!
+void loop() {
+    if (module.newAddress != 0) {
+        Wire.begin(module.newAddress);
+        module.newAddress = 0;
+    }
+
+#if ENCODER_I2C_FEATURE_WATCH
+    module.windows.update(module.value);
+#endif
+}
@@ -14,15 +14,37 @@
 
 #include <Arduino.h>
 #include <Wire.h>
+#include <stddef.h>
 
-#include "rr_DebugUtils.h"
 #include "rr_Encoder-i2c-common.h"
+#include "rr_Encoder-i2c-trace.h"
+
+#if ENCODER_I2C_FEATURE_DEBUG
+    #include "rr_DebugUtils.h"
+#endif
+
+#ifdef __AVR__
+    #include <util/atomic.h>
+
+    //! entries may be logged from Wire callbacks (interrupt context)
+    #define ERROR_LOG_ATOMIC ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+#elif ENCODER_I2C_THREADS
+//! entries may be logged and popped by several tasks
+static std::mutex errorLogMutex;
+
+    #define ERROR_LOG_ATOMIC ENCODER_I2C_LOCKED(errorLogMutex)
+#else
+    #define ERROR_LOG_ATOMIC
+#endif
+
+EncoderI2CErrorLog EncoderI2CErrors;
 
 //!
 //! @brief send data over i2c interface
 //!
 //! @param data point to the data buffer
-//! @param count number of bytes to be sent. Note that count cannot be greater than 32
+//! @param count number of bytes to be sent. Note that count cannot be greater than 32,
+//! larger blocks are transferred in chunks, see requestChunk()
 //!
 void sendData(byte* data, byte count) {
     for (byte loop = 0; loop < count; loop++) {
@@ -33,34 +55,161 @@ void sendData(byte* data, byte count) {
 //!
 //! @brief receive data over i2c interface
 //!
+//! Errors are recorded in EncoderI2CErrors
+//!
 //! @param data point to the data buffer
 //! @param count number of bytes to be received
+//! @param address i2c address of the sender (for the error log only)
+//! @param command the command answered by the sender (for the error log only)
+//! @return byte number of received bytes
 //!
-void receiveData(byte* data, byte count) {
-    for (byte loop = 0; loop < count; loop++) {
+byte receiveData(byte* data, byte count, byte address, EncoderI2CCommands_t command) {
+    byte loop;
+
+    for (loop = 0; loop < count; loop++) {
         if (dataAvailable()) {
             data[loop] = Wire.read();
         }
         else {
-            PRINT_ERROR("Data not available, expected %d, received %d", count, loop);
+            EncoderI2CErrors.log(Error_Missing, address, command, count, loop);
             break;
         }
     }
 
+    byte surplus = 0;
+
     while (dataAvailable()) {
-        byte b = Wire.read();
+        Wire.read();
 
-        PRINT_ERROR("Surplus data received %x", b);
+        surplus++;
+    }
+
+    if (surplus > 0) {
+        EncoderI2CErrors.log(Error_Surplus, address, command, count, loop + surplus);
     }
 
 // getWireTimeoutFlag() not implemented for ATTINY
 #ifndef ARDUINO_AVR_ATTINYX5
     if (Wire.getWireTimeoutFlag()) {
-        PRINT_ERROR("I2C timeout occured", NULL);
+        EncoderI2CErrors.log(Error_Timeout, address, command, count, loop);
 
         Wire.clearWireTimeoutFlag();
     }
 #endif
+
+    return loop;
+}
+
+//!
+//! @brief write a transmission to a module
+//!
+//! @param address i2c address of the module
+//! @param data point to the data buffer
+//! @param count number of bytes to be sent
+//! @return byte result of Wire.endTransmission(), 0 on success
+//!
+byte transmitData(byte address, const byte* data, byte count) {
+    Wire.beginTransmission(address);
+    sendData((byte*)data, count);
+
+    byte result = Wire.endTransmission();
+
+    EncoderI2CTrace.record(Trace_Write, address, result, data, count);
+
+    return result;
+}
+
+//!
+//! @brief request data from a module
+//!
+//! Errors are recorded in EncoderI2CErrors
+//!
+//! @param address i2c address of the module
+//! @param data point to the data buffer
+//! @param count number of bytes to be received
+//! @param command the command answered by the module (for the error log only)
+//! @return byte number of received bytes
+//!
+byte requestData(byte address, byte* data, byte count, EncoderI2CCommands_t command) {
+    Wire.requestFrom(address, count);
+
+    byte received = receiveData(data, count, address, command);
+
+    EncoderI2CTrace.record(Trace_Read, address, count, data, received);
+
+    return received;
+}
+
+//!
+//! @brief request a chunk of a block in one round trip
+//!
+//! The command and the request are sent in one transmission and the module answers
+//! within its Wire callbacks, so no command delay is needed. Errors are recorded in
+//! EncoderI2CErrors. An empty chunk without Bulk_End is a framing error, otherwise a
+//! firmware that makes no progress would keep the caller requesting the same offset
+//!
+//! @param address i2c address of the module
+//! @param request block, offset and length (at most ENCODER_I2C_BULK_CHUNK) of the chunk
+//! @param data receives the chunk
+//! @param end receives true if the chunk contains the end of the block
+//! @return byte number of received bytes, ENCODER_I2C_CHUNK_FAILED on NACK or framing error
+//!
+byte requestChunk(byte address, const EncoderI2CBulkRequest_t& request, byte* data, boolean& end) {
+    byte                   frame[ENCODER_I2C_BUFFER_SIZE];
+    EncoderI2CBulkHeader_t header;
+    byte                   length = request.length < ENCODER_I2C_BULK_CHUNK ? request.length : ENCODER_I2C_BULK_CHUNK;
+
+    frame[0] = Get_Bulk;
+    memcpy(frame + 1, &request, sizeof(request));
+    frame[1 + offsetof(EncoderI2CBulkRequest_t, length)] = length;
+
+    if (transmitData(address, frame, 1 + sizeof(request)) != 0) {
+        EncoderI2CErrors.log(Error_Nack, address, Get_Bulk, length, 0);
+
+        return ENCODER_I2C_CHUNK_FAILED;
+    }
+
+    byte received = requestData(address, frame, sizeof(header) + length, Get_Bulk);
+
+    memcpy(&header, frame, sizeof(header));
+
+    if (received != sizeof(header) + length || header.offset != request.offset || header.length > length ||
+        (header.length == 0 && (header.flags & Bulk_End) == 0)) {
+        EncoderI2CErrors.log(Error_Framing, address, Get_Bulk, length, received);
+
+        return ENCODER_I2C_CHUNK_FAILED;
+    }
+
+    memcpy(data, frame + sizeof(header), header.length);
+    end = (header.flags & Bulk_End) != 0;
+
+    return header.length;
+}
+
+//!
+//! @brief copy a chunk of a block in memory, e.g. in the bulk handler of the module
+//!
+//! @param source the block
+//! @param size size of the block
+//! @param offset offset of the chunk
+//! @param data receives the chunk
+//! @param length requested bytes
+//! @param end receives true if the chunk contains the end of the block
+//! @return byte number of copied bytes
+//!
+byte copyChunk(const byte* source, size_t size, uint16_t offset, byte* data, byte length, boolean& end) {
+    if (offset >= size) {
+        end = true;
+
+        return 0;
+    }
+
+    byte count = min((size_t)length, size - offset);
+
+    memcpy(data, source + offset, count);
+    end = offset + count >= size;
+
+    return count;
 }
 
 //!
@@ -75,3 +224,164 @@ boolean dataAvailable(void) {
     return Wire.available() > 0;
 #endif
 }
+
+#if ENCODER_I2C_ERROR_LOG_SIZE > 0
+
+//!
+//! @brief Construct a new, empty error log
+//!
+EncoderI2CErrorLog::EncoderI2CErrorLog() {
+    first = 0;
+    used  = 0;
+    lost  = 0;
+}
+
+//!
+//! @brief add an entry to the log
+//!
+//! @param kind see EncoderI2CErrorKind_t
+//! @param address i2c address
+//! @param command last command
+//! @param expected expected number of bytes
+//! @param received received number of bytes
+//!
+void EncoderI2CErrorLog::log(byte kind, byte address, EncoderI2CCommands_t command, byte expected, byte received) {
+    EncoderI2CError_t entry;
+
+    entry.timestamp = millis();
+    entry.kind      = kind;
+    entry.address   = address;
+    entry.command   = command;
+    entry.expected  = expected;
+    entry.received  = received;
+
+    ERROR_LOG_ATOMIC {
+        if (used == ENCODER_I2C_ERROR_LOG_SIZE) {
+            // overwrite oldest entry
+            first = (first + 1) % ENCODER_I2C_ERROR_LOG_SIZE;
+            used--;
+            lost++;
+        }
+
+        entries[(first + used) % ENCODER_I2C_ERROR_LOG_SIZE] = entry;
+
+        used++;
+    }
+
+#if ENCODER_I2C_FEATURE_DEBUG
+    char text[80];
+
+    format(entry, text, sizeof(text));
+    PRINT_ERROR("%s", text);
+#endif
+}
+
+//!
+//! @brief get and remove the oldest entry
+//!
+//! @param error receives the entry
+//! @return boolean true if an entry was available
+//!
+boolean EncoderI2CErrorLog::pop(EncoderI2CError_t& error) {
+    boolean result = false;
+
+    ERROR_LOG_ATOMIC {
+        if (used > 0) {
+            error  = entries[first];
+            first  = (first + 1) % ENCODER_I2C_ERROR_LOG_SIZE;
+            result = true;
+
+            used--;
+        }
+    }
+
+    return result;
+}
+
+//!
+//! @brief number of entries in the log
+//!
+//! @return byte the number of entries
+//!
+byte EncoderI2CErrorLog::count(void) {
+    byte result;
+
+    ERROR_LOG_ATOMIC {
+        result = used;
+    }
+
+    return result;
+}
+
+//!
+//! @brief number of entries overwritten because the log was full
+//!
+//! @return unsigned the number of lost entries
+//!
+unsigned EncoderI2CErrorLog::dropped(void) {
+    unsigned result;
+
+    ERROR_LOG_ATOMIC {
+        result = lost;
+    }
+
+    return result;
+}
+
+//!
+//! @brief remove all entries
+//!
+void EncoderI2CErrorLog::clear(void) {
+    ERROR_LOG_ATOMIC {
+        first = 0;
+        used  = 0;
+        lost  = 0;
+    }
+}
+
+//!
+//! @brief create a human readable text of an entry
+//!
+//! @param error the entry
+//! @param buffer the text buffer
+//! @param size size of the text buffer
+//! @return int the length of the text, see snprintf()
+//!
+int EncoderI2CErrorLog::format(const EncoderI2CError_t& error, char* buffer, size_t size) {
+    const char* text;
+
+    switch (error.kind) {
+    case Error_Missing:
+        text = "Data not available";
+        break;
+
+    case Error_Surplus:
+        text = "Surplus data received";
+        break;
+
+    case Error_Timeout:
+        text = "I2C timeout occured";
+        break;
+
+    case Error_NotAcked:
+        text = "Write not acknowledged";
+        break;
+
+    case Error_Nack:
+        text = "Address not acknowledged";
+        break;
+
+    case Error_Framing:
+        text = "Chunk does not match request";
+        break;
+
+    default:
+        text = "Unknown error";
+        break;
+    }
+
+    return snprintf(buffer, size, "%lu: %s, address 0x%02x, command 0x%02x, expected %d, received %d",
+                    error.timestamp, text, error.address, error.command, error.expected, error.received);
+}
+
+#endif
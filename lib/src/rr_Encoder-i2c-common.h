@@ -17,6 +17,83 @@
 //! default i2c slave address
 #define ENCODER_I2C_ADDRESS 0x10
 
+//! protocol features. Define a feature as 0 (e.g. -D ENCODER_I2C_FEATURE_VERSION=0)
+//! to compile out its commands, handlers and buffers on host and module
+#ifndef ENCODER_I2C_FEATURE_VERSION
+    #define ENCODER_I2C_FEATURE_VERSION 1 //!< Get_Version
+#endif
+
+#ifndef ENCODER_I2C_FEATURE_CONFIG
+    #define ENCODER_I2C_FEATURE_CONFIG 1 //!< Set_Config
+#endif
+
+#ifndef ENCODER_I2C_FEATURE_LIMITS
+    #define ENCODER_I2C_FEATURE_LIMITS 1 //!< Set_LowerLimit, Set_UpperLimit
+#endif
+
+#ifndef ENCODER_I2C_FEATURE_WATCH
+    #define ENCODER_I2C_FEATURE_WATCH 1 //!< Set_Watch, Get_WatchFlags
+#endif
+
+#ifndef ENCODER_I2C_FEATURE_STATUS
+    #define ENCODER_I2C_FEATURE_STATUS 1 //!< Get_Status
+#endif
+
+#ifndef ENCODER_I2C_FEATURE_BULK
+    #define ENCODER_I2C_FEATURE_BULK 1 //!< Get_Bulk
+#endif
+
+//! number of watch windows of a module (at most 8)
+#ifndef ENCODER_I2C_WATCH_COUNT
+    #define ENCODER_I2C_WATCH_COUNT 4
+#endif
+
+//! print logged errors immediately with rr_DebugUtils (debugging aid only)
+#ifndef ENCODER_I2C_FEATURE_DEBUG
+    #define ENCODER_I2C_FEATURE_DEBUG 0
+#endif
+
+//! true if the platform supports std::thread and std::mutex (ESP32 and native builds)
+#ifndef ENCODER_I2C_THREADS
+    #if defined(ESP32) || !defined(ARDUINO)
+        #define ENCODER_I2C_THREADS 1
+    #else
+        #define ENCODER_I2C_THREADS 0
+    #endif
+#endif
+
+#if ENCODER_I2C_THREADS
+    #include <mutex>
+
+    //! runs the following block once with the std::mutex held, like ATOMIC_BLOCK
+    #define ENCODER_I2C_LOCKED(lockable) \
+        for (std::unique_lock<std::mutex> guard(lockable); guard.owns_lock(); guard.unlock())
+#endif
+
+//! feature bits
+enum {
+    Feature_Base    = 0x00, //!< always available
+    Feature_Version = 0x01, //!< firmware version string
+    Feature_Config  = 0x02, //!< module configuration
+    Feature_Limits  = 0x04, //!< lower and upper limit
+    Feature_Watch   = 0x08, //!< watch windows
+    Feature_Status  = 0x10, //!< all readings in one response
+    Feature_Bulk    = 0x20  //!< chunked transfer of large blocks
+};
+
+//! the features selected at compile time
+constexpr byte EncoderI2CFeatures = (ENCODER_I2C_FEATURE_VERSION ? Feature_Version : 0) |
+                                    (ENCODER_I2C_FEATURE_CONFIG ? Feature_Config : 0) |
+                                    (ENCODER_I2C_FEATURE_LIMITS ? Feature_Limits : 0) |
+                                    (ENCODER_I2C_FEATURE_WATCH ? Feature_Watch : 0) |
+                                    (ENCODER_I2C_FEATURE_STATUS ? Feature_Status : 0) |
+                                    (ENCODER_I2C_FEATURE_BULK ? Feature_Bulk : 0);
+
+//! check if a feature is part of a feature set
+constexpr boolean featureEnabled(byte feature, byte features = EncoderI2CFeatures) {
+    return (features & feature) == feature;
+}
+
 //! I2C commands. Use fixed bit size to prevent problems with other platforms
 typedef uint8_t EncoderI2CCommands_t;
 
@@ -32,12 +109,25 @@ enum {
     Set_Address    = 0x60, //!< set i2c address
     Get_Version    = 0x70, //!< get version of slave firmware
     Reset_Module   = 0x71, //!< reset the module
-    Set_Config     = 0x72  //!< set configuration
+    Set_Config     = 0x72, //!< set configuration
+    Get_Sequence   = 0x73, //!< get write sequence counter
+    Set_Watch      = 0x74, //!< set a watch window
+    Get_WatchFlags = 0x75, //!< get and clear the latched watch flags
+    Get_Status     = 0x76, //!< get position, direction and button at once
+    Get_Bulk       = 0x77  //!< get a chunk of a block, the request follows in the same transmission
 };
 
 //! encoder position type. Use fixed bit size to prevent problems with other platforms
 typedef int32_t EncoderI2CPosition_t;
 
+//! write sequence counter. The module increments it once a Set_xxx command has been applied.
+//! The counter wraps around, so compare with sequenceReached()
+typedef uint8_t EncoderI2CSequence_t;
+
+//! token of a write not acknowledged by the bus. The counter starts at 0 but skips it on wrap
+//! around, so no applied write has this token
+#define ENCODER_I2C_WRITE_FAILED 0
+
 //! type for the version string
 typedef char EncoderI2CVersion_t[32];
 
@@ -48,14 +138,228 @@ typedef enum {
     Backward = 0x20  //!< backwar movement
 } EncoderI2CDirection_t;
 
+//! latched watch flags, bit n is set once the position has crossed a bound of window n
+typedef uint8_t EncoderI2CWatchFlags_t;
+
+static_assert(ENCODER_I2C_WATCH_COUNT <= 8 * sizeof(EncoderI2CWatchFlags_t), "too many watch windows");
+
+//! a watch window, low > high disables the window. Packed to have the same layout on all platforms
+typedef struct __attribute__((packed)) {
+    byte                 index; //!< window number, 0 .. ENCODER_I2C_WATCH_COUNT - 1
+    EncoderI2CPosition_t low;   //!< lower bound (inclusive)
+    EncoderI2CPosition_t high;  //!< upper bound (inclusive)
+} EncoderI2CWatch_t;
+
+//! response of Get_Status. Packed to have the same layout on all platforms
+typedef struct __attribute__((packed)) {
+    EncoderI2CPosition_t position;  //!< current encoder value
+    uint8_t              direction; //!< last direction (EncoderI2CDirection_t), cleared on read
+    uint8_t              button;    //!< push button status
+} EncoderI2CStatus_t;
+
+//! size of the Wire buffer, the largest transmission in either direction
+#define ENCODER_I2C_BUFFER_SIZE 32
+
+//! blocks for Get_Bulk
+enum {
+    Bulk_Version = 0x00, //!< the version string, not limited to EncoderI2CVersion_t
+    Bulk_User    = 0x80  //!< first block specific to the firmware
+};
+
+//! request of Get_Bulk. Packed to have the same layout on all platforms
+typedef struct __attribute__((packed)) {
+    uint8_t  block;  //!< the block, see Bulk_Version
+    uint16_t offset; //!< offset of the chunk within the block
+    uint8_t  length; //!< requested bytes, at most ENCODER_I2C_BULK_CHUNK
+} EncoderI2CBulkRequest_t;
+
+//! response of Get_Bulk, followed by exactly the requested number of bytes
+typedef struct __attribute__((packed)) {
+    uint16_t offset; //!< offset of the chunk, same as requested
+    uint8_t  length; //!< valid bytes, the rest is padding
+    uint8_t  flags;  //!< see Bulk_End
+} EncoderI2CBulkHeader_t;
+
+//! flags of EncoderI2CBulkHeader_t
+enum {
+    Bulk_End = 0x01 //!< the chunk contains the end of the block
+};
+
+//! largest chunk of Get_Bulk
+#define ENCODER_I2C_BULK_CHUNK (ENCODER_I2C_BUFFER_SIZE - sizeof(EncoderI2CBulkHeader_t))
+
 //! encoder configuration
 typedef struct {
     boolean invertSwitch : 1; //!< invert level of switch ( 1 => pressed = logic low )
 } EncoderI2Config_t;
 
+//! payload and response size of a command
+typedef struct {
+    EncoderI2CCommands_t command;  //!< the command
+    byte                 request;  //!< size of the payload sent by the master after the command
+    byte                 response; //!< size of the response requested by the master
+    byte                 feature;  //!< feature bit of the command
+} EncoderI2CCommandInfo_t;
+
+//! the protocol in one table
+constexpr EncoderI2CCommandInfo_t EncoderI2CCommandTable[] = {
+    {Get_Position, 0, sizeof(EncoderI2CPosition_t), Feature_Base},
+    {Get_Direction, 0, sizeof(EncoderI2CDirection_t), Feature_Base},
+    {Get_Button, 0, sizeof(boolean), Feature_Base},
+    {Set_Position, sizeof(EncoderI2CPosition_t), 0, Feature_Base},
+    {Set_Increment, sizeof(EncoderI2CPosition_t), 0, Feature_Base},
+    {Set_LowerLimit, sizeof(EncoderI2CPosition_t), 0, Feature_Limits},
+    {Set_UpperLimit, sizeof(EncoderI2CPosition_t), 0, Feature_Limits},
+    {Set_Address, sizeof(byte), 0, Feature_Base},
+    {Get_Version, 0, sizeof(EncoderI2CVersion_t), Feature_Version},
+    {Reset_Module, 0, 0, Feature_Base},
+    {Set_Config, sizeof(EncoderI2Config_t), 0, Feature_Config},
+    {Get_Sequence, 0, sizeof(EncoderI2CSequence_t), Feature_Base},
+    {Set_Watch, sizeof(EncoderI2CWatch_t), 0, Feature_Watch},
+    {Get_WatchFlags, 0, sizeof(EncoderI2CWatchFlags_t), Feature_Watch},
+    {Get_Status, 0, sizeof(EncoderI2CStatus_t), Feature_Status},
+    {Get_Bulk, sizeof(EncoderI2CBulkRequest_t), ENCODER_I2C_BUFFER_SIZE, Feature_Bulk},
+};
+
+//! number of commands
+constexpr byte EncoderI2CCommandCount = sizeof(EncoderI2CCommandTable) / sizeof(EncoderI2CCommandTable[0]);
+
+//! index of a command in EncoderI2CCommandTable, EncoderI2CCommandCount if unknown
+constexpr byte commandIndex(EncoderI2CCommands_t cmd, byte index = 0) {
+    return index >= EncoderI2CCommandCount || EncoderI2CCommandTable[index].command == cmd
+               ? index
+               : commandIndex(cmd, index + 1);
+}
+
+//! size of the payload of a command
+constexpr byte requestSize(EncoderI2CCommands_t cmd) {
+    return commandIndex(cmd) < EncoderI2CCommandCount ? EncoderI2CCommandTable[commandIndex(cmd)].request : 0;
+}
+
+//! size of the response of a command
+constexpr byte responseSize(EncoderI2CCommands_t cmd) {
+    return commandIndex(cmd) < EncoderI2CCommandCount ? EncoderI2CCommandTable[commandIndex(cmd)].response : 0;
+}
+
+//! check if a command is part of a feature set
+constexpr boolean commandEnabled(EncoderI2CCommands_t cmd, byte features = EncoderI2CFeatures) {
+    return commandIndex(cmd) < EncoderI2CCommandCount &&
+           featureEnabled(EncoderI2CCommandTable[commandIndex(cmd)].feature, features);
+}
+
+//! number of entries in the error log, 0 strips the error log entirely
+#ifndef ENCODER_I2C_ERROR_LOG_SIZE
+    #define ENCODER_I2C_ERROR_LOG_SIZE 8
+#endif
+
+//! kinds of logged errors
+typedef enum {
+    Error_Missing  = 0x01, //!< less data received than expected
+    Error_Surplus  = 0x02, //!< more data received than expected
+    Error_Timeout  = 0x03, //!< i2c timeout
+    Error_NotAcked = 0x04, //!< write not acknowledged by the module in time
+    Error_Nack     = 0x05, //!< address not acknowledged
+    Error_Framing  = 0x06  //!< chunk does not match its request
+} EncoderI2CErrorKind_t;
+
+//! an entry of the error log
+typedef struct {
+    unsigned long        timestamp; //!< millis() when the error occurred
+    byte                 kind;      //!< see EncoderI2CErrorKind_t
+    byte                 address;   //!< i2c address, 0 if unknown
+    EncoderI2CCommands_t command;   //!< last command, 0 if unknown
+    byte                 expected;  //!< expected number of bytes (or sequence)
+    byte                 received;  //!< received number of bytes (or sequence)
+} EncoderI2CError_t;
+
+//!
+//! @brief fixed size ring buffer for errors
+//!
+//! Logging only stores a few bytes, so it is cheap enough for time critical sections
+//! and interrupt handlers. Draining and formatting should be done later. If the log is
+//! full, the oldest entry is overwritten. Access is atomic on AVR and guarded by a mutex
+//! on platforms with threads, so tasks can log and drain at the same time
+//!
+class EncoderI2CErrorLog {
+  public:
+#if ENCODER_I2C_ERROR_LOG_SIZE > 0
+    EncoderI2CErrorLog();
+
+    // add an entry
+    void log(byte kind, byte address, EncoderI2CCommands_t command, byte expected, byte received);
+
+    // get and remove the oldest entry
+    boolean pop(EncoderI2CError_t& error);
+
+    // number of entries in the log
+    byte count(void);
+
+    // number of overwritten entries
+    unsigned dropped(void);
+
+    // remove all entries
+    void clear(void);
+
+    // human readable text of an entry
+    static int format(const EncoderI2CError_t& error, char* buffer, size_t size);
+
+  protected:
+    EncoderI2CError_t entries[ENCODER_I2C_ERROR_LOG_SIZE]; //!< the ring buffer
+    byte              first;                               //!< index of the oldest entry
+    byte              used;                                //!< number of entries
+    unsigned          lost;                                //!< number of overwritten entries
+#else
+    void log(byte, byte, EncoderI2CCommands_t, byte, byte) {
+    }
+
+    boolean pop(EncoderI2CError_t&) {
+        return false;
+    }
+
+    byte count(void) {
+        return 0;
+    }
+
+    unsigned dropped(void) {
+        return 0;
+    }
+
+    void clear(void) {
+    }
+
+    static int format(const EncoderI2CError_t&, char*, size_t) {
+        return 0;
+    }
+#endif
+};
+
+//! the error log of sendData() / receiveData()
+extern EncoderI2CErrorLog EncoderI2CErrors;
+
+//! check if a sequence counter has reached a given token (wrap around safe)
+inline boolean sequenceReached(EncoderI2CSequence_t counter, EncoderI2CSequence_t token) {
+    return (int8_t)(counter - token) >= 0;
+}
+
+//! the counter after the next write, ENCODER_I2C_WRITE_FAILED is skipped
+inline EncoderI2CSequence_t sequenceNext(EncoderI2CSequence_t counter) {
+    return counter == (EncoderI2CSequence_t)~ENCODER_I2C_WRITE_FAILED ? ENCODER_I2C_WRITE_FAILED + 1 : counter + 1;
+}
+
 //! send / receive data
 void sendData(byte* data, byte count);
-void receiveData(byte* data, byte count);
+byte receiveData(byte* data, byte count, byte address = 0, EncoderI2CCommands_t command = 0);
+
+//! complete transactions of the master, recorded by EncoderI2CTrace
+byte transmitData(byte address, const byte* data, byte count);
+byte requestData(byte address, byte* data, byte count, EncoderI2CCommands_t command = 0);
+
+//! chunked transfer, see Get_Bulk
+byte requestChunk(byte address, const EncoderI2CBulkRequest_t& request, byte* data, boolean& end);
+byte copyChunk(const byte* source, size_t size, uint16_t offset, byte* data, byte length, boolean& end);
+
+//! result of requestChunk() if the chunk has not been received
+#define ENCODER_I2C_CHUNK_FAILED 0xff
 
 //! check if data is availabe on i2c
 boolean dataAvailable(void);
@@ -0,0 +1,731 @@
+//!
+//! @author M. Nickels
+//! @brief Slave side of the protocol for ATtiny85 based encoder wth i2c
+//!
+//! @copyright Copyright (c) 2022
+//!
+//! This file is part of the Library "RREncoderI2C".
+//!
+//!      Creative Commons Attribution-ShareAlike 4.0 International License.
+//!
+//! To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/4.0/
+//! or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+//!
+
+#pragma once
+
+#include <Wire.h>
+
+#include "rr_Encoder-i2c-common.h"
+
+#ifdef __AVR__
+    #include <util/atomic.h>
+
+    //! the Wire callbacks run in interrupt context
+    #define ENCODER_I2C_ATOMIC ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+#else
+    #define ENCODER_I2C_ATOMIC
+#endif
+
+//! request size of a table entry, 0 if its feature is not selected
+constexpr byte enabledRequest(byte features, byte index) {
+    return featureEnabled(EncoderI2CCommandTable[index].feature, features) ? EncoderI2CCommandTable[index].request : 0;
+}
+
+//! response size of a table entry, 0 if its feature is not selected
+constexpr byte enabledResponse(byte features, byte index) {
+    return featureEnabled(EncoderI2CCommandTable[index].feature, features) ? EncoderI2CCommandTable[index].response
+                                                                           : 0;
+}
+
+//! the largest payload of the selected features
+constexpr byte maxRequestSize(byte features = EncoderI2CFeatures, byte index = 0) {
+    return index >= EncoderI2CCommandCount ? 0
+           : enabledRequest(features, index) > maxRequestSize(features, index + 1)
+               ? enabledRequest(features, index)
+               : maxRequestSize(features, index + 1);
+}
+
+//! the largest response of the selected features
+constexpr byte maxResponseSize(byte features = EncoderI2CFeatures, byte index = 0) {
+    return index >= EncoderI2CCommandCount ? 0
+           : enabledResponse(features, index) > maxResponseSize(features, index + 1)
+               ? enabledResponse(features, index)
+               : maxResponseSize(features, index + 1);
+}
+
+//! size of the request buffer
+constexpr byte EncoderI2CMaxRequest = maxRequestSize();
+
+//! size of the response buffer
+constexpr byte EncoderI2CMaxResponse = maxResponseSize();
+
+static_assert(maxResponseSize(0xff) <= 32, "response exceeds the Wire buffer");
+
+//! selects overloads of disabled features at compile time
+template <boolean enabled> struct EncoderI2CFeatureTag {};
+
+//!
+//! @brief handles the commands of the master within the Wire callbacks
+//!
+//! The response to a command is prepared in onReceive(), so the following
+//! requestFrom() of the master is answered immediately by onRequest() and the master
+//! needs no delay after a command. Both run in interrupt context, therefore the
+//! handler functions must be short.
+//!
+//! The Handler class of the firmware provides these functions, the functions of
+//! features not selected by Features are not needed:
+//!
+//!     EncoderI2CPosition_t   position(void);
+//!     EncoderI2CDirection_t  direction(void);           // last direction, cleared on read
+//!     boolean                button(void);
+//!     void                   version(EncoderI2CVersion_t version);
+//!     void                   setPosition(EncoderI2CPosition_t position);
+//!     void                   setIncrement(EncoderI2CPosition_t increment);
+//!     void                   setLowerLimit(EncoderI2CPosition_t limit);
+//!     void                   setUpperLimit(EncoderI2CPosition_t limit);
+//!     void                   setAddress(byte address);  // re-initialize Wire outside the callback
+//!     void                   setConfig(EncoderI2Config_t config);
+//!     void                   setWatch(const EncoderI2CWatch_t& watch);
+//!     EncoderI2CWatchFlags_t watchFlags(void);          // latched flags, cleared on read
+//!     byte                   bulk(byte block, uint16_t offset, byte* data, byte length, boolean& end);
+//!     void                   reset(void);
+//!
+//! Usage:
+//!
+//!     EncoderI2CDispatcher<Encoder> dispatcher(encoder);
+//!
+//!     Wire.onReceive([](int count) { dispatcher.onReceive(count); });
+//!     Wire.onRequest([]() { dispatcher.onRequest(); });
+//!
+template <class Handler, byte Features = EncoderI2CFeatures> class EncoderI2CDispatcher {
+
+  public:
+    //!
+    //! @brief Construct a new EncoderI2CDispatcher object
+    //!
+    //! @param newHandler the firmware functions
+    //!
+    EncoderI2CDispatcher(Handler& newHandler) : handler(newHandler) {
+        clear();
+    }
+
+    //!
+    //! @brief Wire.onReceive() callback
+    //!
+    //! @param count number of received bytes
+    //!
+    void onReceive(int count) {
+        byte data[1 + maxRequestSize(Features)];
+        byte received = 0;
+
+        while (dataAvailable()) {
+            byte value = Wire.read();
+
+            if (received < sizeof(data)) {
+                data[received++] = value;
+            }
+        }
+
+        receive(data, received);
+    }
+
+    //!
+    //! @brief Wire.onRequest() callback
+    //!
+    void onRequest(void) {
+        sendData(response, responseCount);
+    }
+
+    //!
+    //! @brief handle a transmission of the master
+    //!
+    //! The transmission is either a command, a command followed by its payload or
+    //! the payload of the previous command
+    //!
+    //! @param data the received bytes
+    //! @param count number of received bytes
+    //!
+    void receive(const byte* data, byte count) {
+        if (count == 0) {
+            return;
+        }
+
+        if (pending != 0) {
+            // payload of the previous command
+            EncoderI2CCommands_t cmd = pending;
+
+            pending = 0;
+            apply(cmd, data, count);
+        }
+        else {
+            dispatch(data[0], data + 1, count - 1);
+        }
+    }
+
+    //!
+    //! @brief copy the prepared response
+    //!
+    //! @param data the buffer
+    //! @param count size of the buffer
+    //! @return byte number of copied bytes
+    //!
+    byte respond(byte* data, byte count) {
+        if (count > responseCount) {
+            count = responseCount;
+        }
+
+        memcpy(data, response, count);
+
+        return count;
+    }
+
+    //!
+    //! @brief the write sequence counter, see Get_Sequence
+    //!
+    //! @return EncoderI2CSequence_t number of applied writes
+    //!
+    EncoderI2CSequence_t sequence(void) {
+        return writes;
+    }
+
+    //!
+    //! @brief forget pending commands, responses and writes
+    //!
+    void clear(void) {
+        pending       = 0;
+        responseCount = 0;
+        writes        = 0;
+    }
+
+  protected:
+    //!
+    //! @brief handle a command
+    //!
+    //! @param cmd the command
+    //! @param payload payload sent together with the command
+    //! @param count size of the payload
+    //!
+    void dispatch(EncoderI2CCommands_t cmd, const byte* payload, byte count) {
+        responseCount = 0;
+
+        switch (cmd) {
+        case Get_Position:
+            prepare(handler.position());
+            break;
+
+        case Get_Direction:
+            prepare(handler.direction());
+            break;
+
+        case Get_Button:
+            prepare(handler.button());
+            break;
+
+        case Get_Version:
+            prepareVersion(EncoderI2CFeatureTag<featureEnabled(Feature_Version, Features)>());
+            break;
+
+        case Get_Sequence:
+            prepare(writes);
+            break;
+
+        case Get_WatchFlags:
+            prepareWatchFlags(EncoderI2CFeatureTag<featureEnabled(Feature_Watch, Features)>());
+            break;
+
+        case Get_Status:
+            prepareStatus(EncoderI2CFeatureTag<featureEnabled(Feature_Status, Features)>());
+            break;
+
+        case Get_Bulk:
+            prepareBulk(EncoderI2CFeatureTag<featureEnabled(Feature_Bulk, Features)>(), payload, count);
+            break;
+
+        case Reset_Module:
+            handler.reset();
+            clear();
+            break;
+
+        case Set_Position:
+        case Set_Increment:
+        case Set_LowerLimit:
+        case Set_UpperLimit:
+        case Set_Address:
+        case Set_Config:
+        case Set_Watch:
+            // the payload of a disabled feature is still expected, so it is never taken for a command
+            expect(cmd, payload, count);
+            break;
+
+        default:
+            // unknown command
+            break;
+        }
+    }
+
+    //!
+    //! @brief apply a Set_xxx command or wait for its payload
+    //!
+    //! @param cmd the command
+    //! @param payload payload sent together with the command
+    //! @param count size of the payload
+    //!
+    void expect(EncoderI2CCommands_t cmd, const byte* payload, byte count) {
+        if (count > 0) {
+            apply(cmd, payload, count);
+        }
+        else {
+            // payload follows in a separate transmission
+            pending = cmd;
+        }
+    }
+
+    //!
+    //! @brief apply a Set_xxx command
+    //!
+    //! @param cmd the command
+    //! @param payload the payload
+    //! @param count size of the payload
+    //!
+    void apply(EncoderI2CCommands_t cmd, const byte* payload, byte count) {
+        EncoderI2CPosition_t value;
+        byte                 address;
+
+        switch (cmd) {
+        case Set_Position:
+            if (!extract(cmd, value, payload, count)) {
+                return;
+            }
+
+            handler.setPosition(value);
+            break;
+
+        case Set_Increment:
+            if (!extract(cmd, value, payload, count)) {
+                return;
+            }
+
+            handler.setIncrement(value);
+            break;
+
+        case Set_LowerLimit:
+        case Set_UpperLimit:
+            if (!applyLimit(EncoderI2CFeatureTag<featureEnabled(Feature_Limits, Features)>(), cmd, payload, count)) {
+                return;
+            }
+            break;
+
+        case Set_Address:
+            if (!extract(cmd, address, payload, count)) {
+                return;
+            }
+
+            handler.setAddress(address);
+            break;
+
+        case Set_Config:
+            if (!applyConfig(EncoderI2CFeatureTag<featureEnabled(Feature_Config, Features)>(), payload, count)) {
+                return;
+            }
+            break;
+
+        case Set_Watch:
+            if (!applyWatch(EncoderI2CFeatureTag<featureEnabled(Feature_Watch, Features)>(), payload, count)) {
+                return;
+            }
+            break;
+
+        default:
+            return;
+        }
+
+        writes = sequenceNext(writes);
+    }
+
+    //!
+    //! @brief prepare the version string as response
+    //!
+    void prepareVersion(EncoderI2CFeatureTag<true>) {
+        handler.version((char*)response);
+        response[sizeof(EncoderI2CVersion_t) - 1] = 0;
+        responseCount                             = sizeof(EncoderI2CVersion_t);
+    }
+
+    //!
+    //! @brief version feature not selected
+    //!
+    void prepareVersion(EncoderI2CFeatureTag<false>) {
+    }
+
+    //!
+    //! @brief apply a new limit
+    //!
+    //! @param cmd Set_LowerLimit or Set_UpperLimit
+    //! @param payload the limit
+    //! @param count size of the payload
+    //! @return boolean true if applied
+    //!
+    boolean applyLimit(EncoderI2CFeatureTag<true>, EncoderI2CCommands_t cmd, const byte* payload, byte count) {
+        EncoderI2CPosition_t value;
+
+        if (!extract(cmd, value, payload, count)) {
+            return false;
+        }
+
+        if (cmd == Set_LowerLimit) {
+            handler.setLowerLimit(value);
+        }
+        else {
+            handler.setUpperLimit(value);
+        }
+
+        return true;
+    }
+
+    //!
+    //! @brief limits feature not selected, the payload is dropped
+    //!
+    //! @return boolean false, no write of this module
+    //!
+    boolean applyLimit(EncoderI2CFeatureTag<false>, EncoderI2CCommands_t, const byte*, byte) {
+        return false;
+    }
+
+    //!
+    //! @brief apply a new configuration
+    //!
+    //! @param payload the configuration
+    //! @param count size of the payload
+    //! @return boolean true if applied
+    //!
+    boolean applyConfig(EncoderI2CFeatureTag<true>, const byte* payload, byte count) {
+        EncoderI2Config_t config;
+
+        if (!extract(Set_Config, config, payload, count)) {
+            return false;
+        }
+
+        handler.setConfig(config);
+
+        return true;
+    }
+
+    //!
+    //! @brief config feature not selected, the payload is dropped
+    //!
+    //! @return boolean false, no write of this module
+    //!
+    boolean applyConfig(EncoderI2CFeatureTag<false>, const byte*, byte) {
+        return false;
+    }
+
+    //!
+    //! @brief prepare the latched watch flags as response
+    //!
+    void prepareWatchFlags(EncoderI2CFeatureTag<true>) {
+        prepare(handler.watchFlags());
+    }
+
+    //!
+    //! @brief watch feature not selected
+    //!
+    void prepareWatchFlags(EncoderI2CFeatureTag<false>) {
+    }
+
+    //!
+    //! @brief prepare all readings as response
+    //!
+    void prepareStatus(EncoderI2CFeatureTag<true>) {
+        EncoderI2CStatus_t status;
+
+        status.position  = handler.position();
+        status.direction = handler.direction();
+        status.button    = handler.button();
+
+        prepare(status);
+    }
+
+    //!
+    //! @brief status feature not selected
+    //!
+    void prepareStatus(EncoderI2CFeatureTag<false>) {
+    }
+
+    //!
+    //! @brief prepare a chunk of a block as response
+    //!
+    //! The response always has the requested length, so the master can check the framing
+    //!
+    //! @param payload the request, sent together with the command
+    //! @param count size of the payload
+    //!
+    void prepareBulk(EncoderI2CFeatureTag<true>, const byte* payload, byte count) {
+        EncoderI2CBulkRequest_t request;
+        EncoderI2CBulkHeader_t  header;
+        boolean                 end = false;
+
+        if (!extract(Get_Bulk, request, payload, count)) {
+            return;
+        }
+
+        byte length = request.length < ENCODER_I2C_BULK_CHUNK ? request.length : ENCODER_I2C_BULK_CHUNK;
+
+        memset(response, 0, sizeof(header) + length);
+
+        header.offset = request.offset;
+        header.length = handler.bulk(request.block, request.offset, response + sizeof(header), length, end);
+        header.flags  = end ? Bulk_End : 0;
+
+        memcpy(response, &header, sizeof(header));
+        responseCount = sizeof(header) + length;
+    }
+
+    //!
+    //! @brief bulk feature not selected
+    //!
+    void prepareBulk(EncoderI2CFeatureTag<false>, const byte*, byte) {
+    }
+
+    //!
+    //! @brief apply a new watch window
+    //!
+    //! @param payload the window
+    //! @param count size of the payload
+    //! @return boolean true if applied
+    //!
+    boolean applyWatch(EncoderI2CFeatureTag<true>, const byte* payload, byte count) {
+        EncoderI2CWatch_t watch;
+
+        if (!extract(Set_Watch, watch, payload, count)) {
+            return false;
+        }
+
+        handler.setWatch(watch);
+
+        return true;
+    }
+
+    //!
+    //! @brief watch feature not selected, the payload is dropped
+    //!
+    //! @return boolean false, no write of this module
+    //!
+    boolean applyWatch(EncoderI2CFeatureTag<false>, const byte*, byte) {
+        return false;
+    }
+
+    //!
+    //! @brief copy the payload into a value
+    //!
+    //! @param cmd the command (for the error log only)
+    //! @param value receives the value
+    //! @param payload the payload
+    //! @param count size of the payload
+    //! @return boolean false if the payload is too short
+    //!
+    template <typename T> boolean extract(EncoderI2CCommands_t cmd, T& value, const byte* payload, byte count) {
+        if (count < sizeof(value)) {
+            EncoderI2CErrors.log(Error_Missing, 0, cmd, sizeof(value), count);
+
+            return false;
+        }
+
+        memcpy(&value, payload, sizeof(value));
+
+        return true;
+    }
+
+    //!
+    //! @brief store a value as response
+    //!
+    //! @param value the value
+    //!
+    template <typename T> void prepare(const T& value) {
+        static_assert(sizeof(T) <= maxResponseSize(Features), "response too large");
+
+        memcpy(response, &value, sizeof(value));
+        responseCount = sizeof(value);
+    }
+
+    //! the firmware functions
+    Handler& handler;
+
+    //! command waiting for its payload
+    EncoderI2CCommands_t pending;
+
+    //! prepared response
+    byte response[maxResponseSize(Features)];
+
+    //! size of the prepared response
+    byte responseCount;
+
+    //! write sequence counter
+    EncoderI2CSequence_t writes;
+};
+
+//!
+//! @brief watch windows of the module firmware
+//!
+//! The firmware calls update() whenever the position changes. Once the position crosses
+//! a bound of a window, i.e. enters or leaves it, the flag of the window is latched until
+//! the host reads the flags. The optional ready line is pulled low while flags are
+//! latched (open drain, so several modules can share one line).
+//!
+//! Usage in the handler of EncoderI2CDispatcher:
+//!
+//!     void                   setWatch(const EncoderI2CWatch_t& watch) { windows.set(watch, position()); }
+//!     EncoderI2CWatchFlags_t watchFlags(void) { return windows.read(); }
+//!
+class EncoderI2CWatchWindows {
+  public:
+    //!
+    //! @brief Construct a new EncoderI2CWatchWindows object with all windows disabled
+    //!
+    //! @param newReadyPin pin of the ready line, -1 if not connected
+    //!
+    EncoderI2CWatchWindows(int newReadyPin = -1) : readyPin(newReadyPin) {
+        clear();
+    }
+
+    //!
+    //! @brief disable all windows and clear the flags
+    //!
+    void clear(void) {
+        ENCODER_I2C_ATOMIC {
+            for (byte loop = 0; loop < ENCODER_I2C_WATCH_COUNT; loop++) {
+                windows[loop].low  = 1;
+                windows[loop].high = 0;
+            }
+
+            inside  = 0;
+            latched = 0;
+            signal();
+        }
+    }
+
+    //!
+    //! @brief set a window, crossing its bounds is detected from now on
+    //!
+    //! @param watch the window, low > high disables it
+    //! @param position the current position
+    //!
+    void set(const EncoderI2CWatch_t& watch, EncoderI2CPosition_t position) {
+        if (watch.index >= ENCODER_I2C_WATCH_COUNT) {
+            return;
+        }
+
+        EncoderI2CWatchFlags_t mask = 1 << watch.index;
+
+        ENCODER_I2C_ATOMIC {
+            windows[watch.index].low  = watch.low;
+            windows[watch.index].high = watch.high;
+
+            inside = contains(watch.index, position) ? inside | mask : inside & ~mask;
+            latched &= ~mask;
+            signal();
+        }
+    }
+
+    //!
+    //! @brief evaluate the windows for a new position
+    //!
+    //! The bounds are read within the atomic block, so a Set_Watch received in between
+    //! cannot mix the old and the new bounds of a window
+    //!
+    //! @param position the new position
+    //! @return EncoderI2CWatchFlags_t the windows crossed by this update
+    //!
+    EncoderI2CWatchFlags_t update(EncoderI2CPosition_t position) {
+        EncoderI2CWatchFlags_t now = 0;
+        EncoderI2CWatchFlags_t crossed;
+
+        ENCODER_I2C_ATOMIC {
+            for (byte loop = 0; loop < ENCODER_I2C_WATCH_COUNT; loop++) {
+                if (contains(loop, position)) {
+                    now |= 1 << loop;
+                }
+            }
+
+            crossed = now ^ inside;
+            inside  = now;
+
+            if (crossed != 0) {
+                latched |= crossed;
+                signal();
+            }
+        }
+
+        return crossed;
+    }
+
+    //!
+    //! @brief get and clear the latched flags
+    //!
+    //! @return EncoderI2CWatchFlags_t the flags latched since the last read
+    //!
+    EncoderI2CWatchFlags_t read(void) {
+        EncoderI2CWatchFlags_t result;
+
+        ENCODER_I2C_ATOMIC {
+            result  = latched;
+            latched = 0;
+            signal();
+        }
+
+        return result;
+    }
+
+    //!
+    //! @brief check for latched flags without clearing them
+    //!
+    //! @return EncoderI2CWatchFlags_t the latched flags
+    //!
+    EncoderI2CWatchFlags_t pending(void) {
+        return latched;
+    }
+
+  protected:
+    //!
+    //! @brief check if a position is within an enabled window
+    //!
+    //! @param index the window
+    //! @param position the position
+    //! @return boolean true if inside
+    //!
+    boolean contains(byte index, EncoderI2CPosition_t position) {
+        return position >= windows[index].low && position <= windows[index].high;
+    }
+
+    //!
+    //! @brief drive the ready line
+    //!
+    void signal(void) {
+        if (readyPin < 0) {
+            return;
+        }
+
+        if (latched != 0) {
+            digitalWrite(readyPin, LOW);
+            pinMode(readyPin, OUTPUT);
+        }
+        else {
+            pinMode(readyPin, INPUT);
+        }
+    }
+
+    //! bounds of the windows
+    struct {
+        EncoderI2CPosition_t low;
+        EncoderI2CPosition_t high;
+    } windows[ENCODER_I2C_WATCH_COUNT];
+
+    //! pin of the ready line, -1 if not connected
+    const int readyPin;
+
+    //! windows containing the last position
+    EncoderI2CWatchFlags_t inside;
+
+    //! flags not yet read by the host
+    volatile EncoderI2CWatchFlags_t latched;
+};
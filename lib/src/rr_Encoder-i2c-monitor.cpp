@@ -0,0 +1,150 @@
+//!
+//! @author M. Nickels
+//! @brief background polling of an ATtiny85 based encoder wth i2c
+//!
+//! @copyright Copyright (c) 2022
+//!
+//! This file is part of the Library "RREncoderI2C".
+//!
+//!      Creative Commons Attribution-ShareAlike 4.0 International License.
+//!
+//! To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/4.0/
+//! or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+//!
+
+#include <Arduino.h>
+
+#include "rr_Encoder-i2c-monitor.h"
+
+#if ENCODER_I2C_THREADS
+
+    #include <chrono>
+
+//!
+//! @brief Construct a new EncoderI2CMonitor object
+//!
+//! @param newEncoder the encoder to be polled
+//!
+EncoderI2CMonitor::EncoderI2CMonitor(EncoderI2C& newEncoder)
+    : encoder(newEncoder), sequence(0), position(0), direction(None), button(false), timestamp(0), count(0),
+      active(false) {
+}
+
+//!
+//! @brief Destroy the EncoderI2CMonitor object, stops background polling
+//!
+EncoderI2CMonitor::~EncoderI2CMonitor() {
+    stop();
+}
+
+//!
+//! @brief read position, direction and button and publish them
+//!
+//! The readings are transferred by EncoderI2C::reading(), one Get_Status transaction if
+//! selected. Concurrent polls wait for each other, so every published snapshot is complete
+//!
+void EncoderI2CMonitor::poll(void) {
+    std::lock_guard<std::mutex> lock(writer);
+    EncoderI2CSnapshot_t        data;
+    EncoderI2CReading_t         current = encoder.reading();
+
+    data.position  = current.position;
+    data.direction = current.direction;
+    data.button    = current.button;
+    data.timestamp = millis();
+    data.count     = count.load(std::memory_order_relaxed) + 1;
+
+    publish(data);
+}
+
+//!
+//! @brief get the latest readings
+//!
+//! Lock free, retries only if poll() is publishing at the same time
+//!
+//! @return EncoderI2CSnapshot_t the latest readings
+//!
+EncoderI2CSnapshot_t EncoderI2CMonitor::snapshot(void) const {
+    EncoderI2CSnapshot_t data;
+    unsigned long        before, after;
+
+    do {
+        before = sequence.load(std::memory_order_acquire);
+
+        data.position  = position.load(std::memory_order_relaxed);
+        data.direction = (EncoderI2CDirection_t)direction.load(std::memory_order_relaxed);
+        data.button    = button.load(std::memory_order_relaxed);
+        data.timestamp = timestamp.load(std::memory_order_relaxed);
+        data.count     = count.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        after = sequence.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+
+    return data;
+}
+
+//!
+//! @brief start polling in a background thread
+//!
+//! @param interval time between two polls in ms
+//! @return boolean true if started, false if already running
+//!
+boolean EncoderI2CMonitor::start(unsigned long interval) {
+    if (active.exchange(true)) {
+        return false;
+    }
+
+    thread = std::thread([this, interval]() {
+        while (active.load()) {
+            poll();
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(interval));
+        }
+    });
+
+    return true;
+}
+
+//!
+//! @brief stop background polling and wait for the thread to finish
+//!
+void EncoderI2CMonitor::stop(void) {
+    active.store(false);
+
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+//!
+//! @brief check if background polling is active
+//!
+//! @return boolean true if the background thread is running
+//!
+boolean EncoderI2CMonitor::running(void) const {
+    return active.load();
+}
+
+//!
+//! @brief publish new readings, the caller holds the writer mutex
+//!
+//! @param data the readings
+//!
+void EncoderI2CMonitor::publish(const EncoderI2CSnapshot_t& data) {
+    unsigned long current = sequence.load(std::memory_order_relaxed);
+
+    sequence.store(current + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    position.store(data.position, std::memory_order_relaxed);
+    direction.store(data.direction, std::memory_order_relaxed);
+    button.store(data.button, std::memory_order_relaxed);
+    timestamp.store(data.timestamp, std::memory_order_relaxed);
+    count.store(data.count, std::memory_order_relaxed);
+
+    sequence.store(current + 2, std::memory_order_release);
+}
+
+#endif
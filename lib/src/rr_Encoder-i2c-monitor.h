@@ -0,0 +1,82 @@
+//!
+//! @author M. Nickels
+//! @brief background polling of an ATtiny85 based encoder wth i2c
+//!
+//! @copyright Copyright (c) 2022
+//!
+//! This file is part of the Library "RREncoderI2C".
+//!
+//!      Creative Commons Attribution-ShareAlike 4.0 International License.
+//!
+//! To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/4.0/
+//! or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+//!
+
+#pragma once
+
+#include "rr_Encoder-i2c.h"
+
+#if ENCODER_I2C_THREADS
+
+    #include <atomic>
+    #include <mutex>
+    #include <thread>
+
+//! the readings of one poll
+typedef struct {
+    EncoderI2CPosition_t  position;  //!< encoder position
+    EncoderI2CDirection_t direction; //!< direction since previous poll
+    boolean               button;    //!< button state
+    unsigned long         timestamp; //!< millis() of the poll
+    unsigned long         count;     //!< number of polls so far, 0 if no poll yet
+} EncoderI2CSnapshot_t;
+
+//!
+//! @brief polls an encoder and publishes the readings for other tasks
+//!
+//! The readings are published with a seqlock, snapshot() never blocks and never touches
+//! the bus. poll() can be called from own tasks and from the background thread started
+//! with start() at the same time, the writers are serialized by a mutex
+//!
+class EncoderI2CMonitor {
+
+  public:
+    EncoderI2CMonitor(EncoderI2C& newEncoder);
+    ~EncoderI2CMonitor();
+
+    // read the encoder once and publish the readings
+    void poll(void);
+
+    // latest published readings
+    EncoderI2CSnapshot_t snapshot(void) const;
+
+    // background polling
+    boolean start(unsigned long interval);
+    void    stop(void);
+    boolean running(void) const;
+
+  protected:
+    void publish(const EncoderI2CSnapshot_t& data);
+
+    //! the polled encoder
+    EncoderI2C& encoder;
+
+    //! seqlock counter, odd while poll() is writing
+    std::atomic<unsigned long> sequence;
+
+    //! published readings
+    std::atomic<EncoderI2CPosition_t> position;
+    std::atomic<byte>                 direction;
+    std::atomic<boolean>              button;
+    std::atomic<unsigned long>        timestamp;
+    std::atomic<unsigned long>        count;
+
+    //! serializes the writers of the seqlock
+    std::mutex writer;
+
+    //! background thread
+    std::thread       thread;
+    std::atomic<bool> active;
+};
+
+#endif
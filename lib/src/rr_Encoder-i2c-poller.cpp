@@ -0,0 +1,200 @@
+//!
+//! @author M. Nickels
+//! @brief adaptive polling of ATtiny85 based encoders wth i2c
+//!
+//! @copyright Copyright (c) 2022
+//!
+//! This file is part of the Library "RREncoderI2C".
+//!
+//!      Creative Commons Attribution-ShareAlike 4.0 International License.
+//!
+//! To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/4.0/
+//! or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+//!
+
+#include <Arduino.h>
+
+#include "rr_Encoder-i2c-poller.h"
+
+//!
+//! @brief Construct a new EncoderI2CPoller object
+//!
+//! @param fastInterval poll interval in ms right after a change
+//! @param idleInterval poll interval in ms of idle encoders
+//!
+EncoderI2CPoller::EncoderI2CPoller(unsigned long fastInterval, unsigned long idleInterval) {
+    used   = 0;
+    decay  = 150;
+    budget = ENCODER_I2C_POLLER_SIZE;
+
+    setIntervals(fastInterval, idleInterval);
+}
+
+//!
+//! @brief add an encoder to be polled
+//!
+//! @param encoder the encoder
+//! @return boolean false if ENCODER_I2C_POLLER_SIZE encoders have already been added
+//!
+boolean EncoderI2CPoller::add(EncoderI2C& encoder) {
+    if (used >= ENCODER_I2C_POLLER_SIZE) {
+        return false;
+    }
+
+    Entry_t& entry = entries[used++];
+
+    memset(&entry, 0, sizeof(entry));
+
+    entry.encoder  = &encoder;
+    entry.interval = fast;
+
+    return true;
+}
+
+//!
+//! @brief set floor and ceiling of the poll interval
+//!
+//! @param fastInterval poll interval in ms right after a change
+//! @param idleInterval poll interval in ms of idle encoders
+//!
+void EncoderI2CPoller::setIntervals(unsigned long fastInterval, unsigned long idleInterval) {
+    fast = fastInterval > 0 ? fastInterval : 1;
+    idle = idleInterval > fast ? idleInterval : fast;
+
+    for (byte loop = 0; loop < used; loop++) {
+        entries[loop].interval = constrain(entries[loop].interval, fast, idle);
+    }
+}
+
+//!
+//! @brief set the growth of the interval for each poll without change
+//!
+//! @param percent new interval in percent of the previous one, e.g. 200 doubles it
+//!
+void EncoderI2CPoller::setDecay(unsigned percent) {
+    decay = percent > 100 ? percent : 101;
+}
+
+//!
+//! @brief limit the number of polls per update()
+//!
+//! @param polls maximum number of encoders polled by one update()
+//!
+void EncoderI2CPoller::setBudget(byte polls) {
+    budget = polls > 0 ? polls : 1;
+}
+
+//!
+//! @brief poll the encoders which are due
+//!
+//! @return byte number of encoders with changes
+//!
+byte EncoderI2CPoller::update(void) {
+    byte changes = 0;
+
+    for (byte loop = 0; loop < used; loop++) {
+        entries[loop].changed = false;
+    }
+
+    unsigned long now = millis();
+
+    for (byte polls = 0; polls < budget; polls++) {
+        Entry_t*      next    = NULL;
+        unsigned long overdue = 0;
+
+        // find the most overdue encoder, encoders polled by this update() are not due anymore
+        for (byte loop = 0; loop < used; loop++) {
+            Entry_t&      entry   = entries[loop];
+            unsigned long elapsed = now - entry.lastPoll;
+
+            if (!entry.polled) {
+                next = &entry;
+                break;
+            }
+
+            if (elapsed >= entry.interval && (next == NULL || elapsed - entry.interval >= overdue)) {
+                next    = &entry;
+                overdue = elapsed - entry.interval;
+            }
+        }
+
+        if (next == NULL) {
+            break;
+        }
+
+        if (poll(*next, now)) {
+            changes++;
+        }
+    }
+
+    return changes;
+}
+
+//!
+//! @brief number of added encoders
+//!
+//! @return byte the number of encoders
+//!
+byte EncoderI2CPoller::count(void) {
+    return used;
+}
+
+//!
+//! @brief the last readings of an encoder
+//!
+//! @param index index of the encoder in the order of add()
+//! @return const EncoderI2CReading_t& the readings
+//!
+const EncoderI2CReading_t& EncoderI2CPoller::reading(byte index) {
+    return entries[index].reading;
+}
+
+//!
+//! @brief check if the last update() detected a change
+//!
+//! @param index index of the encoder in the order of add()
+//! @return boolean true if position, direction or button have changed
+//!
+boolean EncoderI2CPoller::changed(byte index) {
+    return entries[index].changed;
+}
+
+//!
+//! @brief the current poll interval of an encoder
+//!
+//! @param index index of the encoder in the order of add()
+//! @return unsigned long the interval in ms
+//!
+unsigned long EncoderI2CPoller::interval(byte index) {
+    return entries[index].interval;
+}
+
+//!
+//! @brief poll an encoder and adapt its interval
+//!
+//! @param entry the encoder
+//! @param now current time
+//! @return boolean true if a change has been detected
+//!
+boolean EncoderI2CPoller::poll(Entry_t& entry, unsigned long now) {
+    EncoderI2CReading_t previous = entry.reading;
+
+    entry.reading = entry.encoder->reading();
+
+    boolean changed = entry.polled && (entry.reading.position != previous.position || entry.reading.direction != None ||
+                                       entry.reading.button != previous.button);
+
+    if (changed) {
+        entry.interval = fast;
+    }
+    else {
+        // exponential decay to the idle interval
+        entry.interval = min(idle, max(entry.interval + 1, entry.interval * decay / 100));
+    }
+
+    entry.lastPoll = now;
+    entry.polled   = true;
+    entry.changed  = changed;
+
+    return changed;
+}
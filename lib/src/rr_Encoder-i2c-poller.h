@@ -0,0 +1,84 @@
+//!
+//! @author M. Nickels
+//! @brief adaptive polling of ATtiny85 based encoders wth i2c
+//!
+//! @copyright Copyright (c) 2022
+//!
+//! This file is part of the Library "RREncoderI2C".
+//!
+//!      Creative Commons Attribution-ShareAlike 4.0 International License.
+//!
+//! To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/4.0/
+//! or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+//!
+
+#pragma once
+
+#include "rr_Encoder-i2c.h"
+
+//! maximum number of encoders per poller
+#ifndef ENCODER_I2C_POLLER_SIZE
+    #define ENCODER_I2C_POLLER_SIZE 4
+#endif
+
+//!
+//! @brief polls encoders with an interval adapted to their activity
+//!
+//! After a change of position, direction or button an encoder is polled with the
+//! fast interval. Each poll without change stretches the interval by the decay factor
+//! until the idle interval is reached. If several encoders are due, the most overdue
+//! ones are polled first, limited by the budget per update()
+//!
+class EncoderI2CPoller {
+
+  public:
+    EncoderI2CPoller(unsigned long fastInterval = 20, unsigned long idleInterval = 500);
+
+    // add an encoder
+    boolean add(EncoderI2C& encoder);
+
+    // configuration
+    void setIntervals(unsigned long fastInterval, unsigned long idleInterval);
+    void setDecay(unsigned percent);
+    void setBudget(byte polls);
+
+    // poll due encoders, call it in loop()
+    byte update(void);
+
+    // results of the encoders
+    byte                       count(void);
+    const EncoderI2CReading_t& reading(byte index);
+    boolean                    changed(byte index);
+    unsigned long              interval(byte index);
+
+  protected:
+    //! state of one encoder
+    typedef struct {
+        EncoderI2C*         encoder;  //!< the encoder
+        EncoderI2CReading_t reading;  //!< last readings
+        unsigned long       lastPoll; //!< millis() of last poll
+        unsigned long       interval; //!< current poll interval in ms
+        boolean             changed;  //!< change detected by the last update()
+        boolean             polled;   //!< polled at least once
+    } Entry_t;
+
+    boolean poll(Entry_t& entry, unsigned long now);
+
+    //! the encoders
+    Entry_t entries[ENCODER_I2C_POLLER_SIZE];
+
+    //! number of encoders
+    byte used;
+
+    //! interval after a change in ms
+    unsigned long fast;
+
+    //! interval of idle encoders in ms
+    unsigned long idle;
+
+    //! growth of the interval per idle poll in percent
+    unsigned decay;
+
+    //! maximum number of polls per update()
+    byte budget;
+};
@@ -0,0 +1,209 @@
+//!
+//! @author M. Nickels
+//! @brief Quadrature stress test for ATtiny85 based encoder wth i2c
+//!
+//! @copyright Copyright (c) 2022
+//!
+//! This file is part of the Library "RREncoderI2C".
+//!
+//!      Creative Commons Attribution-ShareAlike 4.0 International License.
+//!
+//! To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/4.0/
+//! or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+//!
+
+#include <Arduino.h>
+
+#include "rr_Encoder-i2c-stress.h"
+
+//! levels of A and B in forward order
+static const byte QUADRATURE[4][2] = {{HIGH, HIGH}, {HIGH, LOW}, {LOW, LOW}, {LOW, HIGH}};
+
+//! number of bisection steps of maxRate()
+#define STRESS_REFINE 4
+
+const EncoderI2CStressProfile_t EncoderI2CStress::DEFAULT_PROFILE = {50, 4, 10000, true, 1, 10};
+
+//!
+//! @brief Construct a new EncoderI2CStress object
+//!
+//! @param newPinA pin of the A signal (CLK)
+//! @param newPinB pin of the B signal (DT)
+//!
+EncoderI2CStress::EncoderI2CStress(byte newPinA, byte newPinB) {
+    pinA  = newPinA;
+    pinB  = newPinB;
+    phase = 0;
+}
+
+//!
+//! @brief set the pins to output, idle level high
+//!
+void EncoderI2CStress::begin(void) {
+    phase = 0;
+
+    output();
+
+    pinMode(pinA, OUTPUT);
+    pinMode(pinB, OUTPUT);
+}
+
+//!
+//! @brief generate a burst of steps
+//!
+//! @param direction 1 forward, -1 backward
+//! @param steps number of steps
+//! @param rate steps per second
+//! @param profile bounce settings
+//! @return EncoderI2CPosition_t the expected change of the position
+//!
+EncoderI2CPosition_t EncoderI2CStress::burst(int8_t direction, unsigned steps, unsigned rate,
+                                             const EncoderI2CStressProfile_t& profile) {
+    unsigned long period = 1000000UL / max(rate, 1U);
+
+    for (unsigned loop = 0; loop < steps; loop++) {
+        step(direction, period, profile);
+    }
+
+    return direction * (EncoderI2CPosition_t)steps;
+}
+
+//!
+//! @brief generate a profile and compare the expected steps with the position of the module
+//!
+//! The position is read in the pause after each burst, so the bus traffic does not
+//! disturb the timing and steps lost in opposite directions do not cancel out
+//!
+//! @param encoder the module
+//! @param profile the profile
+//! @param rate steps per second
+//! @return EncoderI2CStressResult_t expected, counted and lost steps
+//!
+EncoderI2CStressResult_t EncoderI2CStress::measure(EncoderI2C& encoder, const EncoderI2CStressProfile_t& profile,
+                                                   unsigned rate) {
+    EncoderI2CStressResult_t result    = {rate, 0, 0, 0};
+    int8_t                   direction = 1;
+
+    encoder.setPosition(0);
+
+    for (unsigned loop = 0; loop < profile.bursts; loop++) {
+        EncoderI2CPosition_t expected = burst(direction, profile.steps, rate, profile);
+
+        // give the module time to digest the last edges
+        wait(profile.pause);
+
+        EncoderI2CPosition_t counted = encoder.position();
+        EncoderI2CPosition_t delta   = counted - result.counted - expected;
+
+        result.expected += expected;
+        result.counted  = counted;
+        result.lost     += delta < 0 ? -delta : delta;
+
+        if (profile.reverse) {
+            direction = -direction;
+        }
+    }
+
+    return result;
+}
+
+//!
+//! @brief find the highest rate without lost steps
+//!
+//! The rate is doubled from minRate until steps are lost or limitRate is reached,
+//! the last interval is refined by bisection
+//!
+//! @param encoder the module
+//! @param profile the profile
+//! @param minRate the first rate to measure in steps per second, clamped to 1..limitRate
+//! @param limitRate the highest rate to measure in steps per second, at least 1
+//! @return unsigned the highest rate without lost steps, 0 if steps are lost at minRate
+//!
+unsigned EncoderI2CStress::maxRate(EncoderI2C& encoder, const EncoderI2CStressProfile_t& profile, unsigned minRate,
+                                   unsigned limitRate) {
+    unsigned good = 0;
+    unsigned bad  = 0;
+    unsigned rate;
+
+    // a rate of 0 would never grow, a rate above the limit must not be measured
+    limitRate = max(limitRate, 1U);
+    rate      = constrain(minRate, 1U, limitRate);
+
+    while (bad == 0 && good < limitRate) {
+        if (measure(encoder, profile, rate).lost == 0) {
+            good = rate;
+            rate = rate > limitRate / 2 ? limitRate : 2 * rate;
+        }
+        else {
+            bad = rate;
+        }
+    }
+
+    if (good == 0 || bad == 0) {
+        return good;
+    }
+
+    for (byte loop = 0; loop < STRESS_REFINE; loop++) {
+        rate = good + (bad - good) / 2;
+
+        if (measure(encoder, profile, rate).lost == 0) {
+            good = rate;
+        }
+        else {
+            bad = rate;
+        }
+    }
+
+    return good;
+}
+
+//!
+//! @brief generate one edge, preceded by the bounce pulses of the profile
+//!
+//! @param direction 1 forward, -1 backward
+//! @param period duration of the step in µs
+//! @param profile the profile
+//!
+void EncoderI2CStress::step(int8_t direction, unsigned long period, const EncoderI2CStressProfile_t& profile) {
+    byte          previous = phase;
+    unsigned long bounced  = 0;
+
+    phase = (phase + 4 + direction) % 4;
+
+    for (byte loop = 0; loop < profile.bounce && bounced + 2 * profile.bounceWidth < period; loop++) {
+        output();
+        wait(profile.bounceWidth);
+
+        phase = previous;
+        output();
+        wait(profile.bounceWidth);
+
+        phase = (phase + 4 + direction) % 4;
+        bounced += 2 * profile.bounceWidth;
+    }
+
+    output();
+    wait(period - bounced);
+}
+
+//!
+//! @brief drive the pins to the current phase
+//!
+void EncoderI2CStress::output(void) {
+    digitalWrite(pinA, QUADRATURE[phase][0]);
+    digitalWrite(pinB, QUADRATURE[phase][1]);
+}
+
+//!
+//! @brief wait without the 16 bit limit of delayMicroseconds()
+//!
+//! @param us time in µs
+//!
+void EncoderI2CStress::wait(unsigned long us) {
+    if (us >= 10000) {
+        delay(us / 1000);
+        us %= 1000;
+    }
+
+    delayMicroseconds(us);
+}
@@ -0,0 +1,81 @@
+//!
+//! @author M. Nickels
+//! @brief Quadrature stress test for ATtiny85 based encoder wth i2c
+//!
+//! @copyright Copyright (c) 2022
+//!
+//! This file is part of the Library "RREncoderI2C".
+//!
+//!      Creative Commons Attribution-ShareAlike 4.0 International License.
+//!
+//! To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/4.0/
+//! or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+//!
+
+#pragma once
+
+#include "rr_Encoder-i2c.h"
+
+//! a stress profile, the rate is set by EncoderI2CStress::measure()
+typedef struct {
+    unsigned      steps;       //!< steps (edges) per burst
+    unsigned      bursts;      //!< number of bursts
+    unsigned long pause;       //!< pause after each burst in µs, the position is read after it
+    boolean       reverse;     //!< reverse the direction after each burst
+    byte          bounce;      //!< bounce pulses injected before each edge
+    unsigned long bounceWidth; //!< width of a bounce pulse in µs
+} EncoderI2CStressProfile_t;
+
+//! result of a stress run
+typedef struct {
+    unsigned             rate;     //!< steps per second
+    EncoderI2CPosition_t expected; //!< steps generated
+    EncoderI2CPosition_t counted;  //!< position reported by the module
+    EncoderI2CPosition_t lost;     //!< sum of the differences per burst
+} EncoderI2CStressResult_t;
+
+//!
+//! @brief generates quadrature signals and counts the steps lost by the module
+//!
+//! The A/B signals are driven with digitalWrite(), like test_Dynamic on a second
+//! Arduino or the pins sampled by the simulated module on the host. One step is one
+//! edge, i.e. one count of the module with increment 1. The forward sequence of (A, B)
+//! is 11, 10, 00, 01 as in encoderCW() of test_Dynamic
+//!
+class EncoderI2CStress {
+
+  public:
+    EncoderI2CStress(byte newPinA, byte newPinB);
+
+    // set the pins to output, idle level high
+    void begin(void);
+
+    // generate a burst, returns the expected change of the position
+    EncoderI2CPosition_t burst(int8_t direction, unsigned steps, unsigned rate,
+                               const EncoderI2CStressProfile_t& profile);
+
+    // generate a profile and compare with the module
+    EncoderI2CStressResult_t measure(EncoderI2C& encoder, const EncoderI2CStressProfile_t& profile, unsigned rate);
+
+    // highest rate without lost steps
+    unsigned maxRate(EncoderI2C& encoder, const EncoderI2CStressProfile_t& profile, unsigned minRate,
+                     unsigned limitRate);
+
+    //! a default profile: 4 bursts of 50 steps with reversals and one bounce per edge
+    static const EncoderI2CStressProfile_t DEFAULT_PROFILE;
+
+  protected:
+    void step(int8_t direction, unsigned long period, const EncoderI2CStressProfile_t& profile);
+    void output(void);
+
+    static void wait(unsigned long us);
+
+    //! pin of the A signal
+    byte pinA;
+
+    //! pin of the B signal
+    byte pinB;
+
+    //! current index in the quadrature sequence
+    byte phase;
+};
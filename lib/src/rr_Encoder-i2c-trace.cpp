@@ -0,0 +1,237 @@
+//!
+//! @author M. Nickels
+//! @brief Recording of the i2c traffic for ATtiny85 based encoder wth i2c
+//!
+//! @copyright Copyright (c) 2022
+//!
+//! This file is part of the Library "RREncoderI2C".
+//!
+//!      Creative Commons Attribution-ShareAlike 4.0 International License.
+//!
+//! To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/4.0/
+//! or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+//!
+
+#include <Arduino.h>
+
+#include "rr_Encoder-i2c-trace.h"
+
+EncoderI2CTracer EncoderI2CTrace;
+
+#if ENCODER_I2C_FEATURE_TRACE && ENCODER_I2C_THREADS
+//! records may be added and popped by several tasks
+static std::mutex traceMutex;
+
+    #define TRACE_ATOMIC ENCODER_I2C_LOCKED(traceMutex)
+#else
+    #define TRACE_ATOMIC
+#endif
+
+//!
+//! @brief encode a record
+//!
+//! @param record the record
+//! @param buffer receives ENCODER_I2C_TRACE_HEADER + record.count bytes
+//! @return byte the size of the encoded record
+//!
+byte EncoderI2CTracer::encode(const EncoderI2CTraceRecord_t& record, byte* buffer) {
+    buffer[0] = record.timestamp;
+    buffer[1] = record.timestamp >> 8;
+    buffer[2] = record.timestamp >> 16;
+    buffer[3] = record.timestamp >> 24;
+    buffer[4] = record.direction;
+    buffer[5] = record.address;
+    buffer[6] = record.result;
+    buffer[7] = record.count;
+
+    memcpy(buffer + ENCODER_I2C_TRACE_HEADER, record.data, record.count);
+
+    return ENCODER_I2C_TRACE_HEADER + record.count;
+}
+
+//!
+//! @brief decode a record
+//!
+//! @param buffer the encoded record
+//! @param size available bytes in buffer
+//! @param record receives the record
+//! @return byte the size of the encoded record, 0 if incomplete or invalid
+//!
+byte EncoderI2CTracer::decode(const byte* buffer, size_t size, EncoderI2CTraceRecord_t& record) {
+    if (size < ENCODER_I2C_TRACE_HEADER || buffer[7] > sizeof(record.data) ||
+        size < (size_t)ENCODER_I2C_TRACE_HEADER + buffer[7]) {
+        return 0;
+    }
+
+    record.timestamp = (uint32_t)buffer[0] | (uint32_t)buffer[1] << 8 | (uint32_t)buffer[2] << 16 |
+                       (uint32_t)buffer[3] << 24;
+    record.direction = buffer[4];
+    record.address   = buffer[5];
+    record.result    = buffer[6];
+    record.count     = buffer[7];
+
+    memcpy(record.data, buffer + ENCODER_I2C_TRACE_HEADER, record.count);
+
+    return ENCODER_I2C_TRACE_HEADER + record.count;
+}
+
+#if ENCODER_I2C_FEATURE_TRACE
+
+static_assert(ENCODER_I2C_TRACE_SIZE >= ENCODER_I2C_TRACE_HEADER + 32, "trace buffer too small for one record");
+
+//!
+//! @brief Construct a new, empty EncoderI2CTracer object
+//!
+EncoderI2CTracer::EncoderI2CTracer() {
+    first  = 0;
+    used   = 0;
+    lost   = 0;
+    active = false;
+    sink   = NULL;
+}
+
+//!
+//! @brief start recording
+//!
+//! @param newSink optional function receiving each encoded record
+//!
+void EncoderI2CTracer::start(EncoderI2CTraceSink_t newSink) {
+    TRACE_ATOMIC {
+        sink   = newSink;
+        active = true;
+    }
+}
+
+//!
+//! @brief stop recording, the recorded transactions are kept
+//!
+void EncoderI2CTracer::stop(void) {
+    TRACE_ATOMIC {
+        active = false;
+    }
+}
+
+//!
+//! @brief check if recording is active
+//!
+//! @return boolean true if recording
+//!
+boolean EncoderI2CTracer::recording(void) {
+    boolean result;
+
+    TRACE_ATOMIC {
+        result = active;
+    }
+
+    return result;
+}
+
+//!
+//! @brief record a transaction if recording is active
+//!
+//! @param direction see EncoderI2CTraceDirection_t
+//! @param address i2c address
+//! @param result write: result of endTransmission(), read: number of requested bytes
+//! @param data the transferred bytes
+//! @param count number of transferred bytes
+//!
+//! The sink is called with the lock held, so it receives the records in ring order
+//!
+void EncoderI2CTracer::record(byte direction, byte address, byte result, const byte* data, byte count) {
+    uint32_t timestamp = micros();
+
+    TRACE_ATOMIC {
+        if (active) {
+            EncoderI2CTraceRecord_t entry;
+            byte                    encoded[ENCODER_I2C_TRACE_HEADER + sizeof(entry.data)];
+
+            entry.timestamp = timestamp;
+            entry.direction = direction;
+            entry.address   = address;
+            entry.result    = result;
+            entry.count     = min(count, (byte)sizeof(entry.data));
+            memcpy(entry.data, data, entry.count);
+
+            byte size = encode(entry, encoded);
+
+            // make room by dropping the oldest records
+            while (ENCODER_I2C_TRACE_SIZE - used < size) {
+                discard();
+                lost++;
+            }
+
+            for (byte loop = 0; loop < size; loop++) {
+                put(encoded[loop]);
+            }
+
+            if (sink != NULL) {
+                sink(encoded, size);
+            }
+        }
+    }
+}
+
+//!
+//! @brief get and remove the oldest record
+//!
+//! @param record receives the record
+//! @return boolean true if a record was available
+//!
+boolean EncoderI2CTracer::pop(EncoderI2CTraceRecord_t& record) {
+    byte    encoded[ENCODER_I2C_TRACE_HEADER + sizeof(record.data)];
+    byte    count  = 0;
+    boolean result = false;
+
+    TRACE_ATOMIC {
+        if (used > 0) {
+            count = ring[(first + ENCODER_I2C_TRACE_HEADER - 1) % ENCODER_I2C_TRACE_SIZE];
+
+            for (byte loop = 0; loop < ENCODER_I2C_TRACE_HEADER + count; loop++) {
+                encoded[loop] = ring[(first + loop) % ENCODER_I2C_TRACE_SIZE];
+            }
+
+            discard();
+
+            result = true;
+        }
+    }
+
+    return result && decode(encoded, ENCODER_I2C_TRACE_HEADER + count, record) > 0;
+}
+
+//!
+//! @brief number of records dropped because the ring was full
+//!
+//! @return unsigned the number of dropped records
+//!
+unsigned EncoderI2CTracer::dropped(void) {
+    unsigned result;
+
+    TRACE_ATOMIC {
+        result = lost;
+    }
+
+    return result;
+}
+
+//!
+//! @brief append a byte to the ring
+//!
+//! @param value the byte
+//!
+void EncoderI2CTracer::put(byte value) {
+    ring[(first + used) % ENCODER_I2C_TRACE_SIZE] = value;
+    used++;
+}
+
+//!
+//! @brief drop the oldest record
+//!
+void EncoderI2CTracer::discard(void) {
+    byte size = ENCODER_I2C_TRACE_HEADER + ring[(first + ENCODER_I2C_TRACE_HEADER - 1) % ENCODER_I2C_TRACE_SIZE];
+
+    first = (first + size) % ENCODER_I2C_TRACE_SIZE;
+    used -= size;
+}
+
+#endif
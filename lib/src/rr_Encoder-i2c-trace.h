@@ -0,0 +1,100 @@
+//!
+//! @author M. Nickels
+//! @brief Recording of the i2c traffic for ATtiny85 based encoder wth i2c
+//!
+//! @copyright Copyright (c) 2022
+//!
+//! This file is part of the Library "RREncoderI2C".
+//!
+//!      Creative Commons Attribution-ShareAlike 4.0 International License.
+//!
+//! To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/4.0/
+//! or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+//!
+
+#pragma once
+
+#include "rr_Encoder-i2c-common.h"
+
+//! recording of the bus traffic, see EncoderI2CTrace
+#ifndef ENCODER_I2C_FEATURE_TRACE
+    #define ENCODER_I2C_FEATURE_TRACE 0
+#endif
+
+//! size of the trace ring buffer in bytes
+#ifndef ENCODER_I2C_TRACE_SIZE
+    #define ENCODER_I2C_TRACE_SIZE 256
+#endif
+
+//! direction of a recorded transaction
+typedef enum {
+    Trace_Write = 0x01, //!< master to module
+    Trace_Read  = 0x02  //!< module to master
+} EncoderI2CTraceDirection_t;
+
+//! size of the encoded header: timestamp (4), direction, address, result, count
+#define ENCODER_I2C_TRACE_HEADER 8
+
+//! a recorded transaction
+typedef struct {
+    uint32_t timestamp; //!< micros() at the end of the transaction
+    byte     direction; //!< see EncoderI2CTraceDirection_t
+    byte     address;   //!< i2c address
+    byte     result;    //!< write: result of endTransmission(), read: number of requested bytes
+    byte     count;     //!< number of transferred bytes
+    byte     data[32];  //!< transferred bytes
+} EncoderI2CTraceRecord_t;
+
+//! receives each encoded record, e.g. to stream it to Serial or a file
+typedef void (*EncoderI2CTraceSink_t)(const byte* data, byte count);
+
+//!
+//! @brief records every transaction of transmitData() and requestData()
+//!
+//! Each record is encoded in ENCODER_I2C_TRACE_HEADER + count bytes (little endian) and
+//! stored in a ring buffer, the oldest records are dropped if the ring is full. In
+//! addition each record can be passed to a sink. The encoded records can be fed back
+//! with the replay driver of the native build (native/EncoderI2CReplay.h). On platforms
+//! with threads, recording and draining are guarded by a mutex
+//!
+class EncoderI2CTracer {
+  public:
+    // encoding, available without ENCODER_I2C_FEATURE_TRACE for the replay of traces
+    static byte encode(const EncoderI2CTraceRecord_t& record, byte* buffer);
+    static byte decode(const byte* buffer, size_t size, EncoderI2CTraceRecord_t& record);
+
+#if ENCODER_I2C_FEATURE_TRACE
+    EncoderI2CTracer();
+
+    // recording mode
+    void    start(EncoderI2CTraceSink_t newSink = NULL);
+    void    stop(void);
+    boolean recording(void);
+
+    // add a transaction
+    void record(byte direction, byte address, byte result, const byte* data, byte count);
+
+    // get and remove the oldest record
+    boolean pop(EncoderI2CTraceRecord_t& record);
+
+    // number of dropped records
+    unsigned dropped(void);
+
+  protected:
+    void put(byte value);
+    void discard(void);
+
+    byte                  ring[ENCODER_I2C_TRACE_SIZE]; //!< the encoded records
+    unsigned              first;                        //!< index of the oldest byte
+    unsigned              used;                         //!< number of used bytes
+    unsigned              lost;                         //!< number of dropped records
+    boolean               active;                       //!< recording mode
+    EncoderI2CTraceSink_t sink;                         //!< optional sink
+#else
+    void record(byte, byte, byte, const byte*, byte) {
+    }
+#endif
+};
+
+//! the recorder of transmitData() / requestData()
+extern EncoderI2CTracer EncoderI2CTrace;
@@ -15,18 +15,39 @@
 #include <Arduino.h>
 #include <Wire.h>
 
-#include "rr_DebugUtils.h"
 #include "rr_Encoder-i2c.h"
 
-//! delay after sendCommand()
-#define COMMAND_DELAY 20
+//! delay after sendCommand() in ms. Modules answering within the Wire callbacks
+//! (see EncoderI2CDispatcher) need no delay, build with ENCODER_I2C_COMMAND_DELAY=0
+#ifndef ENCODER_I2C_COMMAND_DELAY
+    #define ENCODER_I2C_COMMAND_DELAY 20
+#endif
+
+#define COMMAND_DELAY ENCODER_I2C_COMMAND_DELAY
+
+#if ENCODER_I2C_THREADS
+std::recursive_mutex EncoderI2CBusLock::mutex;
+#endif
+
+EncoderI2C::SequenceSlot EncoderI2C::sequences[ENCODER_I2C_SEQUENCE_SLOTS];
 
 //!
 //! @brief Construct a new EncoderI2C object with default address
 //!
 //!
 EncoderI2C::EncoderI2C() {
-    address = ENCODER_I2C_ADDRESS;
+    address       = ENCODER_I2C_ADDRESS;
+    lastCommand   = 0;
+    lastSequence  = 0;
+    sequenceValid = false;
+    sequenceKnown = true;
+    cacheAge      = 0;
+    cacheTime     = 0;
+    cacheValid    = false;
+
+    cache.position  = 0;
+    cache.direction = None;
+    cache.button    = false;
 }
 
 //!
@@ -47,6 +68,16 @@ EncoderI2C::EncoderI2C(int newAddress) : EncoderI2C() {
 //! @return EncoderI2CPosition_t the encoder position
 //!
 EncoderI2CPosition_t EncoderI2C::position(void) {
+    EncoderI2CBusLock lock;
+
+    if (cacheAge > 0) {
+        if (!cacheFresh()) {
+            fetch();
+        }
+
+        return cache.position;
+    }
+
     sendCommand(Get_Position);
 
     return receivePosition();
@@ -59,49 +90,52 @@ EncoderI2CPosition_t EncoderI2C::position(void) {
 //! constrained by the lower and upper limit, the position shall be within those
 //! limits and a multiple of the increment
 //!
+//! The call returns as soon as the module has applied the new value (or
+//! WRITE_TIMEOUT has elapsed)
+//!
 //! @param position new position
+//! @return EncoderI2CSequence_t token of this write, see waitForWrite()
 //!
-void EncoderI2C::setPosition(EncoderI2CPosition_t position) {
-    sendCommand(Set_Position);
+EncoderI2CSequence_t EncoderI2C::setPosition(EncoderI2CPosition_t position) {
+    EncoderI2CSequence_t token = writePosition(Set_Position, position);
 
-    sendPosition(position);
+    // the encoder transfers the new value in its main loop
+    waitForWrite(token);
 
-    // give the encoder the chance to reach the main loop to transfer the new value
-    delay(200);
+    return token;
 }
 
 //!
 //! @brief set the increment for each position
 //!
 //! @param increment new increment
+//! @return EncoderI2CSequence_t token of this write, see waitForWrite()
 //!
-void EncoderI2C::setIncrement(EncoderI2CPosition_t increment) {
-    sendCommand(Set_Increment);
-
-    sendPosition(increment);
+EncoderI2CSequence_t EncoderI2C::setIncrement(EncoderI2CPosition_t increment) {
+    return writePosition(Set_Increment, increment);
 }
 
+#if ENCODER_I2C_FEATURE_LIMITS
 //!
 //! @brief set the lower limit for the position
 //!
 //! @param limit new lower limit
+//! @return EncoderI2CSequence_t token of this write, see waitForWrite()
 //!
-void EncoderI2C::setLowerLimit(EncoderI2CPosition_t limit) {
-    sendCommand(Set_LowerLimit);
-
-    sendPosition(limit);
+EncoderI2CSequence_t EncoderI2C::setLowerLimit(EncoderI2CPosition_t limit) {
+    return writePosition(Set_LowerLimit, limit);
 }
 
 //!
 //! @brief set the upper limit for the position
 //!
 //! @param limit new upper limit
+//! @return EncoderI2CSequence_t token of this write, see waitForWrite()
 //!
-void EncoderI2C::setUpperLimit(EncoderI2CPosition_t limit) {
-    sendCommand(Set_UpperLimit);
-
-    sendPosition(limit);
+EncoderI2CSequence_t EncoderI2C::setUpperLimit(EncoderI2CPosition_t limit) {
+    return writePosition(Set_UpperLimit, limit);
 }
+#endif
 
 //!
 //! @brief read the last direction
@@ -111,6 +145,21 @@ void EncoderI2C::setUpperLimit(EncoderI2CPosition_t limit) {
 //!         occurred
 //!
 EncoderI2CDirection_t EncoderI2C::direction(void) {
+    EncoderI2CBusLock lock;
+
+    if (cacheAge > 0) {
+        if (!cacheFresh()) {
+            fetch();
+        }
+
+        // served once, like the module clears it on read
+        EncoderI2CDirection_t result = cache.direction;
+
+        cache.direction = None;
+
+        return result;
+    }
+
     sendCommand(Get_Direction);
 
     return receiveDirection();
@@ -122,23 +171,98 @@ EncoderI2CDirection_t EncoderI2C::direction(void) {
 //! @return boolean true if button pressed or false otherwise
 //!
 boolean EncoderI2C::button(void) {
+    EncoderI2CBusLock lock;
+
+    if (cacheAge > 0) {
+        if (!cacheFresh()) {
+            fetch();
+        }
+
+        return cache.button;
+    }
+
     sendCommand(Get_Button);
 
     return receiveBoolean();
 }
 
+//!
+//! @brief read position, direction and button
+//!
+//! With ENCODER_I2C_FEATURE_STATUS the readings are transferred by one Get_Status
+//! transaction, otherwise by three. Fresh cached readings are served without bus access
+//!
+//! @return EncoderI2CReading_t the readings, the direction is cleared on read
+//!
+EncoderI2CReading_t EncoderI2C::reading(void) {
+    EncoderI2CBusLock   lock;
+    EncoderI2CReading_t result;
+
+    if (cacheAge > 0) {
+        if (!cacheFresh()) {
+            fetch();
+        }
+
+        // served once, like the module clears it on read
+        result          = cache;
+        cache.direction = None;
+
+        return result;
+    }
+
+#if ENCODER_I2C_FEATURE_STATUS
+    sendCommand(Get_Status);
+
+    return receiveStatus();
+#else
+    result.position  = position();
+    result.direction = direction();
+    result.button    = button();
+
+    return result;
+#endif
+}
+
 //!
 //! @brief set new i2c address for module
 //!
 //! @param newAddress the new i2c address
+//! @return EncoderI2CSequence_t token of this write, see waitForWrite()
 //!
-void EncoderI2C::setAddress(byte newAddress) {
-    sendCommand(Set_Address);
+EncoderI2CSequence_t EncoderI2C::setAddress(byte newAddress) {
+    EncoderI2CBusLock    lock;
+    EncoderI2CSequence_t token  = nextSequence();
+    byte                 result = sendCommand(Set_Address);
+
+    if (result == 0) {
+        result = sendAddress(newAddress);
+    }
+
+    token = confirmWrite(token, result);
+
+    if (token == ENCODER_I2C_WRITE_FAILED) {
+        // the module keeps its address
+        return token;
+    }
+
+    // the module keeps its counter, follow it to the new address
+    EncoderI2CSequence_t* last = sequenceSlot(address, false);
+
+    forgetSequence(newAddress);
+
+    if (last != NULL) {
+        EncoderI2CSequence_t* moved = sequenceSlot(newAddress, true);
+
+        *moved = *last;
+        forgetSequence(address);
+    }
 
-    sendAddress(newAddress);
     address = newAddress;
+
+    return token;
 }
 
+#if ENCODER_I2C_FEATURE_VERSION
 //!
 //! @brief read the version of the module
 //!
@@ -147,86 +271,615 @@ void EncoderI2C::setAddress(byte newAddress) {
 String EncoderI2C::version(void) {
     EncoderI2CVersion_t versionString;
 
+    version(versionString);
+
+    return String(versionString);
+}
+
+//!
+//! @brief read the version of the module without String
+//!
+//! @param versionString receives the version of the module firmware
+//!
+void EncoderI2C::version(EncoderI2CVersion_t versionString) {
     // initialize string
     memset(versionString, 0, sizeof(EncoderI2CVersion_t));
 
+    EncoderI2CBusLock lock;
+
     sendCommand(Get_Version);
-    Wire.requestFrom(address, sizeof(EncoderI2CVersion_t));
-    receiveData((byte*)versionString, sizeof(versionString));
+    requestData(address, (byte*)versionString, sizeof(EncoderI2CVersion_t), lastCommand);
 
-    return String(versionString);
+    // ensure termination
+    versionString[sizeof(EncoderI2CVersion_t) - 1] = 0;
 }
+#endif
 
+#if ENCODER_I2C_FEATURE_CONFIG
 //!
 //! @brief Set configuration of encoder module
 //!
 //! @param config the new configuration
+//! @return EncoderI2CSequence_t token of this write, see waitForWrite()
+//!
+EncoderI2CSequence_t EncoderI2C::setConfig(EncoderI2Config_t config) {
+    EncoderI2CBusLock    lock;
+    EncoderI2CSequence_t token  = nextSequence();
+    byte                 result = sendCommand(Set_Config);
+
+    if (result == 0) {
+        result = sendConfig(config);
+    }
+
+    return confirmWrite(token, result);
+}
+#endif
+
+#if ENCODER_I2C_FEATURE_WATCH
+//!
+//! @brief Set a watch window of the module
+//!
+//! The module latches the flag of the window once the position enters or leaves it,
+//! see readWatchFlags()
+//!
+//! @param index window number, 0 .. ENCODER_I2C_WATCH_COUNT - 1
+//! @param low lower bound (inclusive), low > high disables the window
+//! @param high upper bound (inclusive)
+//! @return EncoderI2CSequence_t token of this write, see waitForWrite()
+//!
+EncoderI2CSequence_t EncoderI2C::setWatch(byte index, EncoderI2CPosition_t low, EncoderI2CPosition_t high) {
+    EncoderI2CWatch_t watch;
+
+    watch.index = index;
+    watch.low   = low;
+    watch.high  = high;
+
+    EncoderI2CBusLock    lock;
+    EncoderI2CSequence_t token  = nextSequence();
+    byte                 result = sendCommand(Set_Watch);
+
+    if (result == 0) {
+        result = sendWatch(watch);
+    }
+
+    return confirmWrite(token, result);
+}
+
+//!
+//! @brief read and clear the latched watch flags of the module
 //!
-void EncoderI2C::setConfig(EncoderI2Config_t config) {
-    sendCommand(Set_Config);
+//! @return EncoderI2CWatchFlags_t bit n is set if window n has been crossed since the last read
+//!
+EncoderI2CWatchFlags_t EncoderI2C::readWatchFlags(void) {
+    EncoderI2CWatchFlags_t data = 0;
+    EncoderI2CBusLock      lock;
+
+    sendCommand(Get_WatchFlags);
+    requestData(address, (byte*)&data, sizeof(data), lastCommand);
 
-    sendConfig(config);
+    return data;
 }
+#endif
 
 //!
 //! @brief reset the module
 //!
 //!
 void EncoderI2C::reset(void) {
+    EncoderI2CBusLock lock;
+
     // send command twice to ensure a kind of failsafe handling
     sendCommand(Reset_Module);
     sendCommand(Reset_Module);
+
+    // the module starts counting from scratch, maybe with a firmware supporting Get_Sequence
+    sequenceValid = false;
+    sequenceKnown = true;
+    forgetSequence(address);
+
+    cacheValid      = false;
+    cache.direction = None;
 }
 
 //!
-//! @brief send a command to the module
+//! @brief read the write sequence counter of the module
 //!
-//! @param cmd the command to be sent
+//! @return EncoderI2CSequence_t number of writes applied by the module
+//!
+EncoderI2CSequence_t EncoderI2C::sequence(void) {
+    EncoderI2CSequence_t data = 0;
+
+    readSequence(data);
+
+    return data;
+}
+
+//!
+//! @brief check if a write has been applied by the module
+//!
+//! @param token the token returned by one of the setXXX() methods
+//! @return boolean true if the module has applied the write, false for ENCODER_I2C_WRITE_FAILED
+//!
+boolean EncoderI2C::writeDone(EncoderI2CSequence_t token) {
+    return token != ENCODER_I2C_WRITE_FAILED && sequenceReached(sequence(), token);
+}
+
+//!
+//! @brief wait until a write has been applied by the module
+//!
+//! Since the module applies writes in order, waiting for the token of the last
+//! write confirms all previous writes as well.
+//!
+//! A firmware without Get_Sequence cannot confirm writes. Once it has not answered
+//! Get_Sequence, the whole timeout is waited instead, like the fixed delay of
+//! setPosition() before writes were acknowledged, and the write is assumed applied
+//!
+//! @param token the token returned by one of the setXXX() methods
+//! @param timeout maximum time to wait in ms
+//! @return boolean true if the module has applied the write, false on timeout or for
+//!         ENCODER_I2C_WRITE_FAILED
+//!
+boolean EncoderI2C::waitForWrite(EncoderI2CSequence_t token, unsigned long timeout) {
+    unsigned long        start = millis();
+    EncoderI2CSequence_t current;
+
+    if (token == ENCODER_I2C_WRITE_FAILED) {
+        // never sent, the NACK has been logged already
+        return false;
+    }
+
+    do {
+        if (!readSequence(current)) {
+            // firmware without Get_Sequence
+            delay(timeout - min(millis() - start, timeout));
+
+            return true;
+        }
+
+        if (sequenceReached(current, token)) {
+            return true;
+        }
+    } while (millis() - start < timeout);
+
+    EncoderI2CErrors.log(Error_NotAcked, address, Get_Sequence, token, current);
+
+    // the module may have been restarted, read its counter again before the next write
+    EncoderI2CBusLock lock;
+
+    forgetSequence(address);
+
+    return false;
+}
+
 //!
-void EncoderI2C::sendCommand(EncoderI2CCommands_t cmd) {
+//! @brief wait until all writes sent so far have been applied by the module
+//!
+//! @param timeout maximum time to wait in ms
+//! @return boolean true if the module has applied all writes, false on timeout
+//!
+boolean EncoderI2C::waitForWrites(unsigned long timeout) {
+    if (!sequenceValid) {
+        // nothing sent since construction or reset
+        return true;
+    }
+
+    return waitForWrite(lastSequence, timeout);
+}
+
+#if ENCODER_I2C_FEATURE_BULK
+//!
+//! @brief read a block of the module in chunks
+//!
+//! Each chunk is one write and one read of the largest size the Wire buffer allows,
+//! without command delay. A chunk failing with NACK or a framing error is retried
+//! BULK_RETRIES times. If it still fails, the transfer can be resumed later with
+//! offset + count
+//!
+//! @param block the block, see Bulk_Version
+//! @param data receives the data
+//! @param size size of the buffer
+//! @param count receives the number of bytes read
+//! @param offset offset within the block to start from
+//! @return boolean true if the end of the block has been reached
+//!
+boolean EncoderI2C::readBulk(byte block, byte* data, size_t size, size_t& count, uint16_t offset) {
+    EncoderI2CBusLock lock;
+    boolean           end = false;
+
 #ifndef ARDUINO_AVR_ATTINYX5
     Wire.setWireTimeout();
 #endif
 
-    Wire.beginTransmission(address);
-    sendData((byte*)&cmd, sizeof(cmd));
-    Wire.endTransmission();
+    lastCommand = Get_Bulk;
+    count       = 0;
+
+    while (count < size && !end) {
+        EncoderI2CBulkRequest_t request;
+        byte                    received = ENCODER_I2C_CHUNK_FAILED;
+
+        request.block  = block;
+        request.offset = offset + count;
+        request.length = min(size - count, (size_t)ENCODER_I2C_BULK_CHUNK);
+
+        for (byte attempt = 0; attempt <= BULK_RETRIES && received == ENCODER_I2C_CHUNK_FAILED; attempt++) {
+            received = requestChunk(address, request, data + count, end);
+        }
+
+        if (received == ENCODER_I2C_CHUNK_FAILED) {
+            // resume at offset + count
+            return false;
+        }
+
+        count += received;
+    }
+
+    return end;
+}
+#endif
+
+//!
+//! @brief set the maximum age of the cached readings
+//!
+//! Within this time position(), direction() and button() are served from the readings
+//! of the last refresh, which fetches all of them at once. A direction is served
+//! once, like the module clears it on read. Writes invalidate the cache
+//!
+//! The age counts from the request of the refresh, so maxAge shall exceed its duration
+//!
+//! @param maxAge maximum age in µs, 0 disables the cache (default)
+//!
+void EncoderI2C::setCacheAge(unsigned long maxAge) {
+    EncoderI2CBusLock lock;
+
+    cacheAge   = maxAge;
+    cacheValid = false;
+}
+
+//!
+//! @brief force the next read to fetch fresh readings
+//!
+void EncoderI2C::invalidate(void) {
+    EncoderI2CBusLock lock;
+
+    cacheValid = false;
+}
+
+//!
+//! @brief fetch all readings into the cache
+//!
+//! @return EncoderI2CReading_t the readings, the direction is still served by direction()
+//!
+EncoderI2CReading_t EncoderI2C::refresh(void) {
+    EncoderI2CBusLock lock;
+
+    fetch();
+
+    return cache;
+}
+
+//!
+//! @brief read position, direction and button of several modules
+//!
+//! Each command is issued to all modules first and the responses are collected
+//! afterwards, so the modules digest the command at the same time. A poll cycle
+//! costs one command delay with ENCODER_I2C_FEATURE_STATUS (Get_Status), three
+//! otherwise, regardless of the number of modules
+//!
+//! @param encoders the modules to be read
+//! @param count number of modules
+//! @param results receives the readings, one per module
+//!
+void EncoderI2C::pollAll(EncoderI2C* encoders[], byte count, EncoderI2CReading_t results[]) {
+    EncoderI2CBusLock lock;
+
+#if ENCODER_I2C_FEATURE_STATUS
+    for (byte loop = 0; loop < count; loop++) {
+        encoders[loop]->issueCommand(Get_Status);
+    }
+
+    delay(COMMAND_DELAY);
+
+    for (byte loop = 0; loop < count; loop++) {
+        results[loop] = encoders[loop]->receiveStatus();
+    }
+#else
+    for (byte loop = 0; loop < count; loop++) {
+        encoders[loop]->issueCommand(Get_Position);
+    }
+
+    delay(COMMAND_DELAY);
+
+    for (byte loop = 0; loop < count; loop++) {
+        results[loop].position = encoders[loop]->receivePosition();
+        encoders[loop]->issueCommand(Get_Direction);
+    }
+
+    delay(COMMAND_DELAY);
+
+    for (byte loop = 0; loop < count; loop++) {
+        results[loop].direction = encoders[loop]->receiveDirection();
+        encoders[loop]->issueCommand(Get_Button);
+    }
+
+    delay(COMMAND_DELAY);
+
+    for (byte loop = 0; loop < count; loop++) {
+        results[loop].button = encoders[loop]->receiveBoolean();
+    }
+#endif
+}
+
+//!
+//! @brief get the token for the next write, call it with EncoderI2CBusLock held
+//!
+//! The module counter is read once per module, afterwards the tokens are counted in
+//! a slot shared by all instances addressing the module. If all slots are in use,
+//! the module counter is read before each write. The token is only taken by
+//! confirmWrite() once the write has been acknowledged
+//!
+//! @return EncoderI2CSequence_t the token for the next write
+//!
+EncoderI2CSequence_t EncoderI2C::nextSequence(void) {
+    // each write may change the readings
+    cacheValid = false;
+
+    EncoderI2CSequence_t* last = sequenceSlot(address, false);
+
+    if (last == NULL) {
+        EncoderI2CSequence_t current = 0;
+
+        readSequence(current);
+
+        last = sequenceSlot(address, true);
+
+        if (last == NULL) {
+            lastSequence = current;
+        }
+        else {
+            *last = current;
+        }
+    }
+
+    return sequenceNext(last != NULL ? *last : lastSequence);
+}
+
+//!
+//! @brief take the token of a write once its transmissions have been acknowledged
+//!
+//! A write not acknowledged by the bus never reaches the module, so its token is
+//! not taken and the shared counter stays in step with the module
+//!
+//! @param token the token of nextSequence()
+//! @param result result of the transmissions, see Wire.endTransmission()
+//! @return EncoderI2CSequence_t the token, ENCODER_I2C_WRITE_FAILED if not acknowledged
+//!
+EncoderI2CSequence_t EncoderI2C::confirmWrite(EncoderI2CSequence_t token, byte result) {
+    if (result != 0) {
+        EncoderI2CErrors.log(Error_Nack, address, lastCommand, token, result);
+
+        return ENCODER_I2C_WRITE_FAILED;
+    }
+
+    EncoderI2CSequence_t* last = sequenceSlot(address, false);
+
+    if (last != NULL) {
+        *last = token;
+    }
+
+    lastSequence  = token;
+    sequenceValid = true;
+
+    return token;
+}
+
+//!
+//! @brief read the write sequence counter of the module
+//!
+//! A module not answering Get_Sequence is taken for a firmware without write
+//! acknowledgement, it is not asked again until reset()
+//!
+//! @param counter receives the counter
+//! @return boolean true if the module has answered
+//!
+boolean EncoderI2C::readSequence(EncoderI2CSequence_t& counter) {
+    EncoderI2CBusLock lock;
+
+    if (!sequenceKnown) {
+        return false;
+    }
+
+    sendCommand(Get_Sequence);
+
+    sequenceKnown = requestData(address, (byte*)&counter, sizeof(counter), lastCommand) == sizeof(counter);
+
+    return sequenceKnown;
+}
+
+//!
+//! @brief find the shared token of a module
+//!
+//! @param moduleAddress i2c address of the module
+//! @param create true to occupy a free slot if the module has none
+//! @return EncoderI2CSequence_t* the last token sent to the module, NULL if none
+//!
+EncoderI2CSequence_t* EncoderI2C::sequenceSlot(int moduleAddress, boolean create) {
+    SequenceSlot* unused = NULL;
+
+    for (byte loop = 0; loop < ENCODER_I2C_SEQUENCE_SLOTS; loop++) {
+        if (sequences[loop].address == moduleAddress) {
+            return &sequences[loop].last;
+        }
+
+        if (sequences[loop].address == 0 && unused == NULL) {
+            unused = &sequences[loop];
+        }
+    }
+
+    if (!create || unused == NULL) {
+        return NULL;
+    }
+
+    unused->address = moduleAddress;
+
+    return &unused->last;
+}
+
+//!
+//! @brief release the slot of a module, e.g. after a reset
+//!
+//! @param moduleAddress i2c address of the module
+//!
+void EncoderI2C::forgetSequence(int moduleAddress) {
+    for (byte loop = 0; loop < ENCODER_I2C_SEQUENCE_SLOTS; loop++) {
+        if (sequences[loop].address == moduleAddress) {
+            sequences[loop].address = 0;
+        }
+    }
+}
+
+//!
+//! @brief send a Set_xxx command with an EncoderI2CPosition_t payload
+//!
+//! @param cmd the command to be sent
+//! @param value the payload
+//! @return EncoderI2CSequence_t token of this write
+//!
+EncoderI2CSequence_t EncoderI2C::writePosition(EncoderI2CCommands_t cmd, EncoderI2CPosition_t value) {
+    // keep token and write together in case of concurrent writers
+    EncoderI2CBusLock    lock;
+    EncoderI2CSequence_t token  = nextSequence();
+    byte                 result = sendCommand(cmd);
+
+    if (result == 0) {
+        result = sendPosition(value);
+    }
+
+    return confirmWrite(token, result);
+}
+
+//!
+//! @brief send a command to the module
+//!
+//! @param cmd the command to be sent
+//! @return byte result of the transmission, see Wire.endTransmission()
+//!
+byte EncoderI2C::sendCommand(EncoderI2CCommands_t cmd) {
+    byte result = issueCommand(cmd);
 
     // give the peripheral some time to digest command
     delay(COMMAND_DELAY);
+
+    return result;
+}
+
+//!
+//! @brief send a command to the module without waiting
+//!
+//! @param cmd the command to be sent
+//! @return byte result of the transmission, see Wire.endTransmission()
+//!
+byte EncoderI2C::issueCommand(EncoderI2CCommands_t cmd) {
+#ifndef ARDUINO_AVR_ATTINYX5
+    Wire.setWireTimeout();
+#endif
+
+    lastCommand = cmd;
+
+    return transmitData(address, (byte*)&cmd, sizeof(cmd));
 }
 
 //!
 //! @brief sends an EncoderI2CPosition_t value to the module
 //!
 //! @param value value to be sent
+//! @return byte result of the transmission, see Wire.endTransmission()
 //!
-void EncoderI2C::sendPosition(EncoderI2CPosition_t value) {
-    Wire.beginTransmission(address);
-    sendData((byte*)&value, sizeof(value));
-    Wire.endTransmission();
+byte EncoderI2C::sendPosition(EncoderI2CPosition_t value) {
+    return transmitData(address, (byte*)&value, sizeof(value));
 }
 
 //!
 //! @brief send an i2c address to the module
 //!
 //! @param newAddress the i2c address
+//! @return byte result of the transmission, see Wire.endTransmission()
 //!
-void EncoderI2C::sendAddress(byte newAddress) {
-    Wire.beginTransmission(address);
-    sendData((byte*)&newAddress, sizeof(newAddress));
-    Wire.endTransmission();
+byte EncoderI2C::sendAddress(byte newAddress) {
+    return transmitData(address, (byte*)&newAddress, sizeof(newAddress));
 }
 
+#if ENCODER_I2C_FEATURE_CONFIG
 //!
 //! @brief send new config to the module
 //!
 //! @param config the new configuration
+//! @return byte result of the transmission, see Wire.endTransmission()
+//!
+byte EncoderI2C::sendConfig(EncoderI2Config_t config) {
+    return transmitData(address, (byte*)&config, sizeof(config));
+}
+#endif
+
+#if ENCODER_I2C_FEATURE_WATCH
+//!
+//! @brief send a watch window to the module
 //!
-void EncoderI2C::sendConfig(EncoderI2Config_t config) {
-    Wire.beginTransmission(address);
-    sendData((byte*)&config, sizeof(config));
-    Wire.endTransmission();
+//! @param watch the window
+//! @return byte result of the transmission, see Wire.endTransmission()
+//!
+byte EncoderI2C::sendWatch(const EncoderI2CWatch_t& watch) {
+    return transmitData(address, (const byte*)&watch, sizeof(watch));
+}
+#endif
+
+//!
+//! @brief check if the cached readings are valid and not older than cacheAge
+//!
+//! @return boolean true if the cache can be served
+//!
+boolean EncoderI2C::cacheFresh(void) {
+    return cacheValid && micros() - cacheTime <= cacheAge;
+}
+
+//!
+//! @brief fetch all readings into the cache
+//!
+//! A direction not yet served by direction() is kept until the module reports a new one
+//!
+void EncoderI2C::fetch(void) {
+    // the readings are as old as the request, not as the response
+    cacheTime = micros();
+
+#if ENCODER_I2C_FEATURE_STATUS
+    EncoderI2CReading_t status;
+
+    sendCommand(Get_Status);
+    status = receiveStatus();
+
+    cache.position = status.position;
+    cache.button   = status.button;
+
+    if (status.direction != None) {
+        cache.direction = status.direction;
+    }
+#else
+    EncoderI2CDirection_t newDirection;
+
+    sendCommand(Get_Position);
+    cache.position = receivePosition();
+
+    sendCommand(Get_Direction);
+    newDirection = receiveDirection();
+
+    sendCommand(Get_Button);
+    cache.button = receiveBoolean();
+
+    if (newDirection != None) {
+        cache.direction = newDirection;
+    }
+#endif
+
+    cacheValid = true;
 }
 
 //!
@@ -237,8 +890,7 @@ void EncoderI2C::sendConfig(EncoderI2Config_t config) {
 boolean EncoderI2C::receiveBoolean(void) {
     boolean data;
 
-    Wire.requestFrom(address, sizeof(data));
-    receiveData((byte*)&data, sizeof(data));
+    requestData(address, (byte*)&data, sizeof(data), lastCommand);
 
     return data;
 }
@@ -251,8 +903,7 @@ boolean EncoderI2C::receiveBoolean(void) {
 EncoderI2CPosition_t EncoderI2C::receivePosition(void) {
     EncoderI2CPosition_t data = 0;
 
-    Wire.requestFrom(address, sizeof(data));
-    receiveData((byte*)&data, sizeof(data));
+    requestData(address, (byte*)&data, sizeof(data), lastCommand);
 
     return data;
 }
@@ -265,8 +916,27 @@ EncoderI2CPosition_t EncoderI2C::receivePosition(void) {
 EncoderI2CDirection_t EncoderI2C::receiveDirection(void) {
     EncoderI2CDirection_t data;
 
-    Wire.requestFrom(address, sizeof(data));
-    receiveData((byte*)&data, sizeof(data));
+    requestData(address, (byte*)&data, sizeof(data), lastCommand);
 
     return data;
-}
\ No newline at end of file
+}
+
+#if ENCODER_I2C_FEATURE_STATUS
+//!
+//! @brief reads the response to Get_Status from the module
+//!
+//! @return EncoderI2CReading_t position, direction and button
+//!
+EncoderI2CReading_t EncoderI2C::receiveStatus(void) {
+    EncoderI2CStatus_t  status = {0, None, false};
+    EncoderI2CReading_t result;
+
+    requestData(address, (byte*)&status, sizeof(status), lastCommand);
+
+    result.position  = status.position;
+    result.direction = (EncoderI2CDirection_t)status.direction;
+    result.button    = status.button;
+
+    return result;
+}
+#endif
\ No newline at end of file
@@ -16,6 +16,46 @@
 
 #include "rr_Encoder-i2c-common.h"
 
+//!
+//! @brief serializes the access to the i2c bus between tasks
+//!
+//! Each logical transaction (command and response) of EncoderI2C holds the lock.
+//! Applications sharing Wire with other tasks can hold it as well. The lock is
+//! recursive and compiles to nothing on platforms without threads
+//!
+class EncoderI2CBusLock {
+  public:
+    EncoderI2CBusLock() {
+#if ENCODER_I2C_THREADS
+        mutex.lock();
+#endif
+    }
+
+    ~EncoderI2CBusLock() {
+#if ENCODER_I2C_THREADS
+        mutex.unlock();
+#endif
+    }
+
+#if ENCODER_I2C_THREADS
+  private:
+    //! one lock for the one Wire instance
+    static std::recursive_mutex mutex;
+#endif
+};
+
+//! number of modules whose write sequence is shared by all EncoderI2C instances
+#ifndef ENCODER_I2C_SEQUENCE_SLOTS
+    #define ENCODER_I2C_SEQUENCE_SLOTS 4
+#endif
+
+//! the readings of one module
+typedef struct {
+    EncoderI2CPosition_t  position;  //!< encoder position
+    EncoderI2CDirection_t direction; //!< last direction
+    boolean               button;    //!< button state
+} EncoderI2CReading_t;
+
 //!
 //! @brief abstraction class for the protocol to the i2c module
 //!
@@ -28,14 +68,16 @@ class EncoderI2C {
 
     // get/set encoder position
     EncoderI2CPosition_t position(void);
-    void                 setPosition(EncoderI2CPosition_t position);
+    EncoderI2CSequence_t setPosition(EncoderI2CPosition_t position);
 
     // set increment
-    void setIncrement(EncoderI2CPosition_t increment);
+    EncoderI2CSequence_t setIncrement(EncoderI2CPosition_t increment);
 
+#if ENCODER_I2C_FEATURE_LIMITS
     // set limits
-    void setLowerLimit(EncoderI2CPosition_t limit);
-    void setUpperLimit(EncoderI2CPosition_t limit);
+    EncoderI2CSequence_t setLowerLimit(EncoderI2CPosition_t limit);
+    EncoderI2CSequence_t setUpperLimit(EncoderI2CPosition_t limit);
+#endif
 
     // last direction
     EncoderI2CDirection_t direction(void);
@@ -43,30 +85,120 @@ class EncoderI2C {
     // current button status
     boolean button(void);
 
+    // position, direction and button at once
+    EncoderI2CReading_t reading(void);
+
     // set new i2c address for module
-    void setAddress(byte newAddress);
+    EncoderI2CSequence_t setAddress(byte newAddress);
 
+#if ENCODER_I2C_FEATURE_VERSION
     // firmware version of module
     String version(void);
+    void   version(EncoderI2CVersion_t versionString);
+#endif
 
+#if ENCODER_I2C_FEATURE_CONFIG
     // set configuration
-    void setConfig(EncoderI2Config_t config);
+    EncoderI2CSequence_t setConfig(EncoderI2Config_t config);
+#endif
+
+#if ENCODER_I2C_FEATURE_WATCH
+    // watch windows evaluated by the module
+    EncoderI2CSequence_t   setWatch(byte index, EncoderI2CPosition_t low, EncoderI2CPosition_t high);
+    EncoderI2CWatchFlags_t readWatchFlags(void);
+#endif
 
     // reset module
     void reset(void);
 
+    // write acknowledgement
+    EncoderI2CSequence_t sequence(void);
+    boolean              writeDone(EncoderI2CSequence_t token);
+    boolean              waitForWrite(EncoderI2CSequence_t token, unsigned long timeout = WRITE_TIMEOUT);
+    boolean              waitForWrites(unsigned long timeout = WRITE_TIMEOUT);
+
+#if ENCODER_I2C_FEATURE_BULK
+    // chunked read of large blocks
+    boolean readBulk(byte block, byte* data, size_t size, size_t& count, uint16_t offset = 0);
+#endif
+
+    // read cache
+    void                setCacheAge(unsigned long maxAge);
+    void                invalidate(void);
+    EncoderI2CReading_t refresh(void);
+
+    // read all modules at once
+    static void pollAll(EncoderI2C* encoders[], byte count, EncoderI2CReading_t results[]);
+
+    //! default timeout in ms for waitForWrite()
+    static const unsigned long WRITE_TIMEOUT = 200;
+
+    //! retries of a chunk after a NACK or framing error
+    static const byte BULK_RETRIES = 3;
+
   protected:
+    // write sequence
+    EncoderI2CSequence_t         nextSequence(void);
+    EncoderI2CSequence_t         confirmWrite(EncoderI2CSequence_t token, byte result);
+    boolean                      readSequence(EncoderI2CSequence_t& counter);
+    static EncoderI2CSequence_t* sequenceSlot(int moduleAddress, boolean create);
+    static void                  forgetSequence(int moduleAddress);
+    EncoderI2CSequence_t         writePosition(EncoderI2CCommands_t cmd, EncoderI2CPosition_t value);
+
     // send data
-    void sendCommand(EncoderI2CCommands_t cmd);
-    void sendPosition(EncoderI2CPosition_t value);
-    void sendAddress(byte newAddress);
-    void sendConfig(EncoderI2Config_t config);
+    byte sendCommand(EncoderI2CCommands_t cmd);
+    byte issueCommand(EncoderI2CCommands_t cmd);
+    byte sendPosition(EncoderI2CPosition_t value);
+    byte sendAddress(byte newAddress);
+#if ENCODER_I2C_FEATURE_CONFIG
+    byte sendConfig(EncoderI2Config_t config);
+#endif
+#if ENCODER_I2C_FEATURE_WATCH
+    byte sendWatch(const EncoderI2CWatch_t& watch);
+#endif
+
+    // read cache
+    boolean cacheFresh(void);
+    void    fetch(void);
 
     // receive data
     boolean               receiveBoolean(void);
     EncoderI2CPosition_t  receivePosition(void);
     EncoderI2CDirection_t receiveDirection(void);
+#if ENCODER_I2C_FEATURE_STATUS
+    EncoderI2CReading_t receiveStatus(void);
+#endif
 
     //! i2c slave address
     int address;
+
+    //! last command sent, for the error log
+    EncoderI2CCommands_t lastCommand;
+
+    //! token of the last write sent to the module
+    EncoderI2CSequence_t lastSequence;
+
+    //! true if a write has been sent since construction or reset
+    boolean sequenceValid;
+
+    //! false once the module has not answered Get_Sequence (firmware without write acknowledgement)
+    boolean sequenceKnown;
+
+    //! last token per module address, shared by all instances, guarded by EncoderI2CBusLock
+    static struct SequenceSlot {
+        byte                 address; //!< module address, 0 if unused
+        EncoderI2CSequence_t last;    //!< last token sent to the module
+    } sequences[ENCODER_I2C_SEQUENCE_SLOTS];
+
+    //! maximum age of the cached readings in µs, 0 disables the cache
+    unsigned long cacheAge;
+
+    //! micros() of the last refresh
+    unsigned long cacheTime;
+
+    //! true if cache holds readings of the module
+    boolean cacheValid;
+
+    //! the cached readings, the direction is cleared once it has been served
+    EncoderI2CReading_t cache;
 };
\ No newline at end of file
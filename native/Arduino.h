@@ -0,0 +1,138 @@
+//!
+//! @author M. Nickels
+//! @brief Minimal Arduino stand-in to run the library natively (Linux, macOS)
+//!
+//! @copyright Copyright (c) 2022
+//!
+//! This file is part of the Library "RREncoderI2C".
+//!
+//!      Creative Commons Attribution-ShareAlike 4.0 International License.
+//!
+//! To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/4.0/
+//! or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+//!
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <thread>
+
+typedef uint8_t byte;
+typedef bool    boolean;
+
+#define LOW  0
+#define HIGH 1
+
+#define INPUT        0x0
+#define OUTPUT       0x1
+#define INPUT_PULLUP 0x2
+
+//! number of simulated pins
+#define NATIVE_PINS 32
+
+//!
+//! @brief subset of the Arduino String class
+//!
+class String : public std::string {
+  public:
+    String() : std::string() {
+    }
+    String(const char* str) : std::string(str) {
+    }
+};
+
+template <typename T> inline T min(T a, T b) {
+    return a < b ? a : b;
+}
+
+template <typename T> inline T max(T a, T b) {
+    return a > b ? a : b;
+}
+
+template <typename T> inline T constrain(T value, T low, T high) {
+    return value < low ? low : value > high ? high : value;
+}
+
+//! simulated time in microseconds. Time only advances with delay() or explicitly
+inline std::atomic<unsigned long> nativeMicros(0);
+
+//! sum of all delays in microseconds
+inline std::atomic<unsigned long> nativeDelayMicros(0);
+
+//!
+//! @brief simulated time in microseconds
+//!
+inline unsigned long micros(void) {
+    return nativeMicros;
+}
+
+//!
+//! @brief simulated time in milliseconds
+//!
+inline unsigned long millis(void) {
+    return nativeMicros / 1000;
+}
+
+//!
+//! @brief advance the simulated time
+//!
+//! The calling thread yields to give other threads the chance to interleave
+//!
+//! @param us delay in microseconds
+//!
+inline void delayMicroseconds(unsigned int us) {
+    nativeMicros += us;
+    nativeDelayMicros += us;
+
+    std::this_thread::yield();
+}
+
+//!
+//! @brief advance the simulated time
+//!
+//! @param ms delay in milliseconds
+//!
+inline void delay(unsigned long ms) {
+    delayMicroseconds(ms * 1000);
+}
+
+//! simulated pins: mode and output level. Inputs read HIGH (external pull-up)
+inline std::atomic<byte> nativePinMode[NATIVE_PINS];
+inline std::atomic<byte> nativePinLevel[NATIVE_PINS];
+
+//! called before a pin changes, e.g. to let a simulated module sample its inputs
+inline std::function<void(void)> nativePinHook;
+
+//!
+//! @brief set the mode of a simulated pin
+//!
+inline void pinMode(byte pin, byte mode) {
+    if (nativePinHook) {
+        nativePinHook();
+    }
+
+    nativePinMode[pin % NATIVE_PINS] = mode;
+}
+
+//!
+//! @brief set the output level of a simulated pin
+//!
+inline void digitalWrite(byte pin, byte level) {
+    if (nativePinHook) {
+        nativePinHook();
+    }
+
+    nativePinLevel[pin % NATIVE_PINS] = level;
+}
+
+//!
+//! @brief read a simulated pin
+//!
+inline int digitalRead(byte pin) {
+    return nativePinMode[pin % NATIVE_PINS] == OUTPUT ? nativePinLevel[pin % NATIVE_PINS].load() : HIGH;
+}
@@ -0,0 +1,241 @@
+//!
+//! @author M. Nickels
+//! @brief Replay of recorded i2c traffic on the simulated i2c bus
+//!
+//! @copyright Copyright (c) 2022
+//!
+//! This file is part of the Library "RREncoderI2C".
+//!
+//!      Creative Commons Attribution-ShareAlike 4.0 International License.
+//!
+//! To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/4.0/
+//! or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+//!
+
+#pragma once
+
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <vector>
+
+#include <Arduino.h>
+#include <Wire.h>
+
+#include "rr_Encoder-i2c-trace.h"
+
+//!
+//! @brief plays the role of a module as recorded by EncoderI2CTrace
+//!
+//! The recorded transactions of one address are played back in order: reads are
+//! answered with the recorded bytes, NACKs are repeated and writes of the host are
+//! compared with the recorded bytes. Deviations of the host from the recording are
+//! counted as mismatches, e.g. to check a fix against production traffic.
+//!
+//! The simulated time follows the recording: if the host reaches a transaction
+//! earlier than recorded, nativeMicros is advanced to the recorded time, so pauses
+//! between transactions (e.g. the age of the read cache) are reproduced. If the host
+//! is later than recorded, the difference is reported by lag()
+//!
+class EncoderI2CReplay : public TwoWireDevice {
+  public:
+    EncoderI2CReplay(int newAddress = ENCODER_I2C_ADDRESS) {
+        i2cAddress = newAddress;
+        clear();
+    }
+
+    //! forget the loaded trace and the statistics
+    void clear(void) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        records.clear();
+        next     = 0;
+        mismatch = 0;
+        start    = 0;
+        last     = 0;
+        late     = 0;
+    }
+
+    //! append the records of this address from an encoded trace, returns the number of records
+    size_t load(const byte* trace, size_t size) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        EncoderI2CTraceRecord_t record;
+        size_t                  offset = 0;
+        size_t                  loaded = 0;
+
+        while (offset < size) {
+            byte length = EncoderI2CTracer::decode(trace + offset, size - offset, record);
+
+            if (length == 0) {
+                // truncated trace
+                break;
+            }
+
+            offset += length;
+
+            if (record.address == i2cAddress) {
+                records.push_back(record);
+                loaded++;
+            }
+        }
+
+        return loaded;
+    }
+
+    //! append the records of this address from a trace file, e.g. captured from a sink
+    size_t load(const char* path) {
+        std::ifstream     file(path, std::ios::binary);
+        std::vector<byte> trace((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        return load(trace.data(), trace.size());
+    }
+
+    //! number of played records
+    size_t played(void) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        return next;
+    }
+
+    //! number of records not yet played
+    size_t remaining(void) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        return records.size() - next;
+    }
+
+    //! number of transactions deviating from the recording
+    unsigned long mismatches(void) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        return mismatch;
+    }
+
+    //! recorded time in µs between the first and the last played record
+    uint32_t recordedTime(void) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        return next > 1 ? records[next - 1].timestamp - records[0].timestamp : 0;
+    }
+
+    //! replayed time in µs between the first and the last played record
+    uint32_t replayedTime(void) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        return next > 1 ? last - start : 0;
+    }
+
+    //! largest delay in µs of a played transaction compared with the recording
+    uint32_t lag(void) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        return late;
+    }
+
+    // TwoWireDevice
+
+    int address(void) override {
+        return i2cAddress;
+    }
+
+    boolean acknowledge(void) override {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        if (next < records.size() && nacked(records[next])) {
+            // the recorded transaction was not acknowledged
+            play();
+
+            return false;
+        }
+
+        return true;
+    }
+
+    void receive(const byte* data, size_t count) override {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        if (next >= records.size()) {
+            mismatch++;
+            return;
+        }
+
+        const EncoderI2CTraceRecord_t& record = records[next];
+
+        if (record.direction != Trace_Write) {
+            // unexpected write, keep waiting for the recorded read
+            mismatch++;
+            return;
+        }
+
+        if (record.count != count || memcmp(record.data, data, count) != 0) {
+            mismatch++;
+        }
+
+        play();
+    }
+
+    size_t request(byte* data, size_t count) override {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        if (next >= records.size()) {
+            mismatch++;
+            return 0;
+        }
+
+        const EncoderI2CTraceRecord_t& record = records[next];
+
+        if (record.direction != Trace_Read) {
+            // unexpected read, keep waiting for the recorded write
+            mismatch++;
+            return 0;
+        }
+
+        if (record.result != count) {
+            mismatch++;
+        }
+
+        count = min(count, (size_t)record.count);
+        memcpy(data, record.data, count);
+        play();
+
+        return count;
+    }
+
+  protected:
+    //! consume the next record and keep the simulated time in step with the recording
+    void play(void) {
+        uint32_t recorded = records[next].timestamp - records[0].timestamp;
+
+        if (next == 0) {
+            start = micros();
+        }
+
+        uint32_t replayed = micros() - start;
+
+        if (replayed < recorded) {
+            nativeMicros += recorded - replayed;
+        }
+        else if (replayed - recorded > late) {
+            late = replayed - recorded;
+        }
+
+        last = micros();
+        next++;
+    }
+
+    //! check if a recorded transaction has not been acknowledged
+    static boolean nacked(const EncoderI2CTraceRecord_t& record) {
+        return record.direction == Trace_Write ? record.result != 0 : record.count == 0;
+    }
+
+    std::recursive_mutex mutex;
+
+    int                                  i2cAddress;
+    std::vector<EncoderI2CTraceRecord_t> records;
+    size_t                               next;
+    unsigned long                        mismatch;
+    uint32_t                             start; //!< micros() when the first record was played
+    uint32_t                             last;  //!< micros() when the last record was played
+    uint32_t                             late;  //!< largest lag behind the recording
+};
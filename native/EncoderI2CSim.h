@@ -0,0 +1,383 @@
+//!
+//! @author M. Nickels
+//! @brief Simulated encoder module for the simulated i2c bus
+//!
+//! @copyright Copyright (c) 2022
+//!
+//! This file is part of the Library "RREncoderI2C".
+//!
+//!      Creative Commons Attribution-ShareAlike 4.0 International License.
+//!
+//! To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/4.0/
+//! or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+//!
+
+#pragma once
+
+#include <limits.h>
+#include <mutex>
+#include <vector>
+
+#include <Arduino.h>
+#include <Wire.h>
+
+#include "rr_Encoder-i2c-module.h"
+
+//!
+//! @brief simulation of the ATtiny85 encoder module
+//!
+//! The commands are handled by EncoderI2CDispatcher like in the firmware. The position
+//! is kept as raw encoder count, which is scaled with the increment and constrained by
+//! the limits. Watch windows are evaluated after each change of the position.
+//!
+//! Instead of rotate() the module can decode quadrature signals on simulated pins,
+//! which are sampled with a fixed period like in the firmware, see connect()
+//!
+class EncoderI2CSim : public TwoWireDevice {
+  public:
+    EncoderI2CSim(int newAddress = ENCODER_I2C_ADDRESS) : dispatcher(*this) {
+        defaultAddress = newAddress;
+        legacy         = false;
+
+        reset();
+    }
+
+    ~EncoderI2CSim() {
+        if (samplePeriod != 0) {
+            disconnect();
+        }
+    }
+
+    //! simulate a rotation by the given number of steps (edges)
+    void rotate(EncoderI2CPosition_t steps) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        if (steps == 0) {
+            return;
+        }
+
+        raw += steps;
+        lastDirection = steps > 0 ? Forward : Backward;
+
+        constrainRaw();
+    }
+
+    //! decode the A/B signals of two simulated pins, sampled every period µs
+    void connect(byte newPinA, byte newPinB, unsigned long period = SAMPLE_PERIOD) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        pinA         = newPinA;
+        pinB         = newPinB;
+        samplePeriod = period;
+        nextSample   = micros();
+        pinState     = pins();
+
+        nativePinHook = [this]() { sample(); };
+    }
+
+    //! stop decoding the pins
+    void disconnect(void) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        samplePeriod  = 0;
+        nativePinHook = nullptr;
+    }
+
+    //! set the level of the button pin
+    void setButtonPin(boolean level) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        buttonLevel = level;
+    }
+
+    //! data of block Bulk_User
+    void setBlock(const byte* data, size_t size) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        block.assign(data, data + size);
+    }
+
+    //! behave like a firmware without Get_Sequence
+    void setLegacy(boolean enable) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        legacy = enable;
+    }
+
+    //! do not acknowledge the next count transactions
+    void nack(unsigned count) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        nacks = count;
+    }
+
+    //! number of applied writes
+    EncoderI2CSequence_t writes(void) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        return dispatcher.sequence();
+    }
+
+    //! number of received transmissions
+    unsigned long transmissions(void) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        return received;
+    }
+
+    // TwoWireDevice
+
+    int address(void) override {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        return i2cAddress;
+    }
+
+    boolean acknowledge(void) override {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        if (nacks > 0) {
+            nacks--;
+
+            return false;
+        }
+
+        return true;
+    }
+
+    void receive(const byte* data, size_t count) override {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        received++;
+
+        // catch up with the pins before answering
+        sample();
+
+        if (legacy && count == 1 && data[0] == Get_Sequence) {
+            // unknown command, nothing to answer
+            const byte unknown = 0xff;
+
+            dispatcher.receive(&unknown, sizeof(unknown));
+            return;
+        }
+
+        dispatcher.receive(data, count);
+    }
+
+    size_t request(byte* data, size_t count) override {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        return dispatcher.respond(data, count);
+    }
+
+    // handler functions of EncoderI2CDispatcher
+
+    //! scaled and constrained position
+    EncoderI2CPosition_t position(void) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        return scaled();
+    }
+
+    //! last direction, cleared on read
+    EncoderI2CDirection_t direction(void) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        EncoderI2CDirection_t result = lastDirection;
+
+        lastDirection = None;
+
+        return result;
+    }
+
+    //! button state
+    boolean button(void) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        return config.invertSwitch ? !buttonLevel : buttonLevel;
+    }
+
+    //! firmware version
+    void version(EncoderI2CVersion_t version) {
+        memset(version, 0, sizeof(EncoderI2CVersion_t));
+        strncpy(version, VERSION, sizeof(EncoderI2CVersion_t) - 1);
+    }
+
+    void setPosition(EncoderI2CPosition_t position) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        raw = position / increment;
+        constrainRaw();
+    }
+
+    void setIncrement(EncoderI2CPosition_t value) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        increment = value != 0 ? value : 1;
+        constrainRaw();
+    }
+
+    void setLowerLimit(EncoderI2CPosition_t limit) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        lowerLimit = limit;
+        constrainRaw();
+    }
+
+    void setUpperLimit(EncoderI2CPosition_t limit) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        upperLimit = limit;
+        constrainRaw();
+    }
+
+    void setAddress(byte newAddress) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        i2cAddress = newAddress;
+    }
+
+    void setConfig(EncoderI2Config_t newConfig) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        config = newConfig;
+    }
+
+    void setWatch(const EncoderI2CWatch_t& watch) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        windows.set(watch, scaled());
+    }
+
+    //! latched watch flags, cleared on read
+    EncoderI2CWatchFlags_t watchFlags(void) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        return windows.read();
+    }
+
+    //! chunk of a block
+    byte bulk(byte index, uint16_t offset, byte* data, byte length, boolean& end) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        switch (index) {
+        case Bulk_Version:
+            return copyChunk((const byte*)VERSION, strlen(VERSION) + 1, offset, data, length, end);
+
+        case Bulk_User:
+            return copyChunk(block.data(), block.size(), offset, data, length, end);
+
+        case STALLED_BLOCK:
+            // no data and no end of data
+            end = false;
+            return 0;
+
+        default:
+            end = true;
+            return 0;
+        }
+    }
+
+    //! restore power-on state
+    void reset(void) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        i2cAddress          = defaultAddress;
+        raw                 = 0;
+        increment           = 1;
+        lowerLimit          = INT32_MIN;
+        upperLimit          = INT32_MAX;
+        lastDirection       = None;
+        buttonLevel         = HIGH;
+        config.invertSwitch = true;
+        received            = 0;
+        nacks               = 0;
+
+        windows.clear();
+        dispatcher.clear();
+    }
+
+    //! firmware version
+    static constexpr const char* VERSION = "rr_Encoder-i2c simulation";
+
+    //! block never making progress, like a faulty firmware
+    static constexpr byte STALLED_BLOCK = Bulk_User + 1;
+
+    //! default sample period of the pins in µs
+    static const unsigned long SAMPLE_PERIOD = 100;
+
+  protected:
+    //! levels of A and B as state 0 .. 3
+    byte pins(void) {
+        return digitalRead(pinA) << 1 | digitalRead(pinB);
+    }
+
+    //! sample the pins if a sample is due. The pins are constant since the last call
+    void sample(void) {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        // change of the position for each transition of (A, B), forward is 11, 10, 00, 01
+        static const int8_t TRANSITIONS[16] = {0, 1, -1, 0, -1, 0, 0, 1, 1, 0, 0, -1, 0, -1, 1, 0};
+
+        unsigned long now = micros();
+
+        if (samplePeriod == 0 || (long)(now - nextSample) < 0) {
+            return;
+        }
+
+        byte state = pins();
+
+        // invalid transitions (both signals changed) are lost
+        rotate(TRANSITIONS[pinState << 2 | state]);
+
+        pinState = state;
+        nextSample += ((now - nextSample) / samplePeriod + 1) * samplePeriod;
+    }
+
+    //! scale the raw position
+    EncoderI2CPosition_t scaled(void) {
+        int64_t value = (int64_t)raw * increment;
+
+        if (value < lowerLimit) {
+            value = lowerLimit;
+        }
+
+        if (value > upperLimit) {
+            value = upperLimit;
+        }
+
+        return (EncoderI2CPosition_t)value;
+    }
+
+    //! keep the raw position within the limits
+    void constrainRaw(void) {
+        raw = scaled() / increment;
+
+        windows.update(scaled());
+    }
+
+    std::recursive_mutex mutex;
+
+    EncoderI2CDispatcher<EncoderI2CSim> dispatcher;
+    EncoderI2CWatchWindows              windows;
+
+    int                   defaultAddress;
+    int                   i2cAddress;
+    EncoderI2CPosition_t  raw;
+    EncoderI2CPosition_t  increment;
+    EncoderI2CPosition_t  lowerLimit;
+    EncoderI2CPosition_t  upperLimit;
+    EncoderI2CDirection_t lastDirection;
+    boolean               buttonLevel;
+    EncoderI2Config_t     config;
+    unsigned long         received;
+    unsigned              nacks;
+    boolean               legacy;
+    std::vector<byte>     block;
+
+    byte          pinA;
+    byte          pinB;
+    byte          pinState;
+    unsigned long samplePeriod = 0;
+    unsigned long nextSample;
+};
@@ -0,0 +1,239 @@
+//!
+//! @author M. Nickels
+//! @brief Simulated i2c bus to run the library natively (Linux, macOS)
+//!
+//! @copyright Copyright (c) 2022
+//!
+//! This file is part of the Library "RREncoderI2C".
+//!
+//!      Creative Commons Attribution-ShareAlike 4.0 International License.
+//!
+//! To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/4.0/
+//! or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+//!
+
+#pragma once
+
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <Arduino.h>
+
+//! size of the Arduino Wire buffer
+#define BUFFER_LENGTH 32
+
+//!
+//! @brief a peripheral attached to the simulated bus
+//!
+class TwoWireDevice {
+  public:
+    virtual ~TwoWireDevice() {
+    }
+
+    //! current i2c address of the device
+    virtual int address(void) = 0;
+
+    //! master has written count bytes to the device
+    virtual void receive(const byte* data, size_t count) = 0;
+
+    //! master requests up to count bytes, returns the number of bytes sent
+    virtual size_t request(byte* data, size_t count) = 0;
+
+    //! the device has been addressed, false simulates an address NACK
+    virtual boolean acknowledge(void) {
+        return true;
+    }
+};
+
+//!
+//! @brief bus statistics
+//!
+typedef struct {
+    unsigned long transactions; //!< number of write and read transactions
+    unsigned long bytesWritten; //!< bytes from master to devices
+    unsigned long bytesRead;    //!< bytes from devices to master
+    unsigned long nacks;        //!< transactions without a device
+    unsigned long violations;   //!< transactions interleaved by different threads
+} TwoWireStatistics_t;
+
+//!
+//! @brief simulated Arduino TwoWire class
+//!
+//! Each call is atomic. A transaction which is interrupted by a different thread
+//! (e.g. beginTransmission() during an open transmission) is counted as a violation
+//!
+class TwoWire {
+  public:
+    void begin(void) {
+    }
+
+    void setWireTimeout(uint32_t = 25000, boolean = false) {
+    }
+
+    boolean getWireTimeoutFlag(void) {
+        return false;
+    }
+
+    void clearWireTimeoutFlag(void) {
+    }
+
+    void beginTransmission(int address) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (transmitting) {
+            stats.violations++;
+        }
+
+        transmitting = true;
+        txOwner      = std::this_thread::get_id();
+        txAddress    = address;
+        txCount      = 0;
+    }
+
+    size_t write(byte data) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (!transmitting || txOwner != std::this_thread::get_id()) {
+            stats.violations++;
+        }
+
+        if (txCount >= BUFFER_LENGTH) {
+            return 0;
+        }
+
+        txBuffer[txCount++] = data;
+
+        return 1;
+    }
+
+    byte endTransmission(boolean = true) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (!transmitting || txOwner != std::this_thread::get_id()) {
+            stats.violations++;
+        }
+
+        transmitting = false;
+        stats.transactions++;
+
+        TwoWireDevice* device = find(txAddress);
+
+        if (device == nullptr || !device->acknowledge()) {
+            stats.nacks++;
+
+            // address NACK
+            return 2;
+        }
+
+        stats.bytesWritten += txCount;
+        device->receive(txBuffer, txCount);
+
+        return 0;
+    }
+
+    byte requestFrom(int address, int quantity) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (rxIndex < rxCount && rxOwner != std::this_thread::get_id()) {
+            stats.violations++;
+        }
+
+        stats.transactions++;
+
+        rxOwner = std::this_thread::get_id();
+        rxIndex = 0;
+        rxCount = 0;
+
+        TwoWireDevice* device = find(address);
+
+        if (device == nullptr || !device->acknowledge()) {
+            stats.nacks++;
+
+            return 0;
+        }
+
+        if (quantity > BUFFER_LENGTH) {
+            quantity = BUFFER_LENGTH;
+        }
+
+        rxCount = device->request(rxBuffer, quantity);
+        stats.bytesRead += rxCount;
+
+        return rxCount;
+    }
+
+    int available(void) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        return rxOwner == std::this_thread::get_id() ? rxCount - rxIndex : 0;
+    }
+
+    int read(void) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (rxOwner != std::this_thread::get_id()) {
+            stats.violations++;
+        }
+
+        return rxIndex < rxCount ? rxBuffer[rxIndex++] : -1;
+    }
+
+    //! attach a simulated device
+    void attach(TwoWireDevice* device) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        devices.push_back(device);
+    }
+
+    //! remove all simulated devices and reset the statistics
+    void detachAll(void) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        devices.clear();
+        stats = {};
+    }
+
+    //! bus statistics
+    TwoWireStatistics_t statistics(void) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        return stats;
+    }
+
+    //! reset bus statistics
+    void resetStatistics(void) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        stats = {};
+    }
+
+  private:
+    TwoWireDevice* find(int address) {
+        for (TwoWireDevice* device : devices) {
+            if (device->address() == address) {
+                return device;
+            }
+        }
+
+        return nullptr;
+    }
+
+    std::mutex                  mutex;
+    std::vector<TwoWireDevice*> devices;
+    TwoWireStatistics_t         stats = {};
+
+    boolean         transmitting = false;
+    std::thread::id txOwner;
+    int             txAddress = 0;
+    byte            txBuffer[BUFFER_LENGTH];
+    size_t          txCount = 0;
+
+    std::thread::id rxOwner;
+    byte            rxBuffer[BUFFER_LENGTH];
+    size_t          rxCount = 0;
+    size_t          rxIndex = 0;
+};
+
+//! the simulated bus
+inline TwoWire Wire;
@@ -0,0 +1,21 @@
+//!
+//! @author M. Nickels
+//! @brief Minimal stand-in for the debug macros of the Library "rr_ArduinoUtils"
+//!
+//! @copyright Copyright (c) 2022
+//!
+//! This file is part of the Library "RREncoderI2C".
+//!
+//!      Creative Commons Attribution-ShareAlike 4.0 International License.
+//!
+//! To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/4.0/
+//! or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+//!
+
+#pragma once
+
+#include <stdio.h>
+
+#define PRINT_ERROR(format, ...) fprintf(stderr, "ERROR " format "\n", __VA_ARGS__)
+#define PRINT_INFO(format, ...)  fprintf(stderr, "INFO  " format "\n", __VA_ARGS__)
+#define PRINT_DEBUG(format, ...) fprintf(stderr, "DEBUG " format "\n", __VA_ARGS__)
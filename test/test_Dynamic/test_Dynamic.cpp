@@ -19,17 +19,22 @@
 #include <unity.h>
 
 //! own includes
+#include "rr_Encoder-i2c-stress.h"
 #include "rr_Encoder-i2c.h"
 
 EncoderI2C encoder;
 
 //! pin definition for hardware encoder simulation
-#define BUTTON_PIN    4
-#define ENCA_PIN      2
-#define ENCB_PIN      3
+#define BUTTON_PIN        4
+#define ENCA_PIN          2
+#define ENCB_PIN          3
 
 //! delay after each signal change
-#define ENCODER_DELAY 100
+#define ENCODER_DELAY     100
+
+//! rates of the stress test in steps per second
+#define STRESS_MIN_RATE   25
+#define STRESS_LIMIT_RATE 5000
 
 //!
 //! @brief simulate press of the button
@@ -189,6 +194,28 @@ void test_SetLowerLimit(void) {
     TEST_ASSERT_EQUAL(-7, encoder.position());
 }
 
+//!
+//! @brief stress test with bursts, reversals and bounce at increasing rates
+//!
+void test_Stress(void) {
+    EncoderI2CStress stress(ENCA_PIN, ENCB_PIN);
+    char             message[80];
+
+    // remove the limits of the previous tests, the module must have applied them before the first burst
+    encoder.setLowerLimit(INT32_MIN);
+    encoder.setUpperLimit(INT32_MAX);
+    TEST_ASSERT_TRUE(encoder.waitForWrites());
+
+    stress.begin();
+
+    unsigned rate = stress.maxRate(encoder, EncoderI2CStress::DEFAULT_PROFILE, STRESS_MIN_RATE, STRESS_LIMIT_RATE);
+
+    snprintf(message, sizeof(message), "highest rate without lost steps: %u steps/s", rate);
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_GREATER_OR_EQUAL(STRESS_MIN_RATE, rate);
+}
+
 //!
 //! @brief Setup routine
 //!
@@ -219,6 +246,7 @@ void setup() {
     RUN_TEST(test_DirectionCCW);
     RUN_TEST(test_SetUpperLimit);
     RUN_TEST(test_SetLowerLimit);
+    RUN_TEST(test_Stress);
 
     // stop unit testing
     UNITY_END();
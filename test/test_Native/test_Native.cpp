@@ -0,0 +1,975 @@
+//!
+
+//! @author M. Nickels
+//! @brief Native unit test against the simulated module
+
+//!
+//! @copyright Copyright (c) 2022
+//!
+//! This work is licensed under the
+//!
+//!      Creative Commons Attribution-NonCommercial 4.0 International License.
+//!
+//! To view a copy of this license, visit http://creativecommons.org/licenses/by-nc/4.0/
+//! or send a letter to Creative Commons, PO Box 1866, Mountain View, CA 94042, USA.
+//!
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <unity.h>
+#include <vector>
+
+//! own includes
+#include "EncoderI2CReplay.h"
+#include "EncoderI2CSim.h"
+#include "rr_Encoder-i2c-monitor.h"
+#include "rr_Encoder-i2c-poller.h"
+#include "rr_Encoder-i2c-stress.h"
+#include "rr_Encoder-i2c-trace.h"
+#include "rr_Encoder-i2c.h"
+
+//! number of concurrent tasks
+#define TASKS          4
+
+//! transactions per task
+#define ITERATIONS     200
+
+//! maximum time of a command handler in ns
+#define HANDLER_BUDGET 50000
+
+//! pins of the simulated quadrature signals, like test_Dynamic
+#define ENCA_PIN       2
+#define ENCB_PIN       3
+
+EncoderI2CSim module;
+EncoderI2C    encoder;
+
+//! trace captured by traceSink()
+std::vector<byte> trace;
+
+//!
+//! @brief collect the encoded trace records
+//!
+void traceSink(const byte* data, byte count) {
+    trace.insert(trace.end(), data, data + count);
+}
+
+//!
+//! @brief attach a fresh module before each test
+//!
+void setUp(void) {
+    Wire.detachAll();
+
+    module.reset();
+    Wire.attach(&module);
+
+    // the write sequence of the module starts from scratch
+    encoder = EncoderI2C();
+    encoder.reset();
+}
+
+//!
+//! @brief nothing to clean up
+//!
+void tearDown(void) {
+}
+
+//!
+//! @brief test the protocol against the simulated module
+//!
+void test_Protocol(void) {
+    TEST_ASSERT_GREATER_THAN(0, encoder.version().length());
+    TEST_ASSERT_EQUAL(0, encoder.position());
+    TEST_ASSERT_FALSE(encoder.button());
+
+    encoder.setPosition(10);
+    TEST_ASSERT_EQUAL(10, encoder.position());
+
+    encoder.setIncrement(5);
+    TEST_ASSERT_EQUAL(50, encoder.position());
+
+    module.rotate(-1);
+    TEST_ASSERT_EQUAL(Backward, encoder.direction());
+    TEST_ASSERT_EQUAL(None, encoder.direction());
+    TEST_ASSERT_EQUAL(45, encoder.position());
+}
+
+//!
+//! @brief test write acknowledgement
+//!
+void test_WriteSequence(void) {
+    EncoderI2CSequence_t token = encoder.setUpperLimit(40);
+
+    TEST_ASSERT_TRUE(encoder.writeDone(token));
+    TEST_ASSERT_EQUAL(token, module.writes());
+
+    encoder.setLowerLimit(-40);
+    encoder.setUpperLimit(30);
+
+    TEST_ASSERT_TRUE(encoder.waitForWrites());
+    TEST_ASSERT_EQUAL(3, module.writes());
+
+    // a write not acknowledged by the bus does not take a token
+    EncoderI2CErrors.clear();
+    module.nack(1);
+
+    TEST_ASSERT_EQUAL(ENCODER_I2C_WRITE_FAILED, encoder.setUpperLimit(20));
+    TEST_ASSERT_FALSE(encoder.waitForWrite(ENCODER_I2C_WRITE_FAILED));
+    TEST_ASSERT_TRUE(encoder.waitForWrites());
+
+    unsigned long start = millis();
+
+    token = encoder.setUpperLimit(20);
+    TEST_ASSERT_TRUE(encoder.waitForWrite(token));
+    TEST_ASSERT_LESS_THAN(EncoderI2C::WRITE_TIMEOUT, millis() - start);
+    TEST_ASSERT_EQUAL(4, module.writes());
+
+#if ENCODER_I2C_ERROR_LOG_SIZE > 0
+    EncoderI2CError_t error;
+
+    TEST_ASSERT_TRUE(EncoderI2CErrors.pop(error));
+    TEST_ASSERT_EQUAL(Error_Nack, error.kind);
+    TEST_ASSERT_EQUAL(Set_UpperLimit, error.command);
+    TEST_ASSERT_FALSE(EncoderI2CErrors.pop(error));
+#endif
+
+    // host and module skip the failed token on wrap around
+    for (unsigned loop = 0; loop < 300; loop++) {
+        token = encoder.setIncrement(1);
+    }
+
+    TEST_ASSERT_NOT_EQUAL(ENCODER_I2C_WRITE_FAILED, token);
+    TEST_ASSERT_TRUE(encoder.waitForWrite(token));
+    TEST_ASSERT_EQUAL(token, module.writes());
+}
+
+//!
+//! @brief firmware without Get_Sequence falls back to the fixed wait of the old protocol
+//!
+void test_LegacyFirmware(void) {
+    module.setLegacy(true);
+    EncoderI2CErrors.clear();
+
+    unsigned long start = millis();
+
+    encoder.setPosition(3);
+    TEST_ASSERT_EQUAL(3, module.position());
+    TEST_ASSERT_GREATER_OR_EQUAL(EncoderI2C::WRITE_TIMEOUT, millis() - start);
+
+    encoder.setPosition(4);
+    TEST_ASSERT_EQUAL(4, module.position());
+    TEST_ASSERT_TRUE(encoder.waitForWrites());
+
+#if ENCODER_I2C_ERROR_LOG_SIZE > 0
+    EncoderI2CError_t error;
+
+    // only the first unanswered Get_Sequence is logged, no write is reported as not acknowledged
+    TEST_ASSERT_EQUAL(1, EncoderI2CErrors.count());
+    TEST_ASSERT_TRUE(EncoderI2CErrors.pop(error));
+    TEST_ASSERT_EQUAL(Error_Missing, error.kind);
+    TEST_ASSERT_EQUAL(Get_Sequence, error.command);
+#endif
+
+    module.setLegacy(false);
+}
+
+//!
+//! @brief instances addressing the same module share the write sequence
+//!
+void test_SharedSequence(void) {
+    EncoderI2C first;
+    EncoderI2C second;
+
+    EncoderI2CSequence_t token1 = first.setIncrement(1);
+    EncoderI2CSequence_t token2 = second.setIncrement(1);
+    EncoderI2CSequence_t token3 = first.setIncrement(1);
+
+    TEST_ASSERT_EQUAL(1, token1);
+    TEST_ASSERT_EQUAL(2, token2);
+    TEST_ASSERT_EQUAL(3, token3);
+    TEST_ASSERT_EQUAL(3, module.writes());
+
+    TEST_ASSERT_TRUE(first.waitForWrite(token3));
+    TEST_ASSERT_TRUE(second.waitForWrites());
+
+    // a restarted module is followed after a timeout
+    module.reset();
+    TEST_ASSERT_FALSE(first.waitForWrite(first.setIncrement(1), 10));
+    TEST_ASSERT_TRUE(second.waitForWrite(second.setIncrement(1)));
+}
+
+//!
+//! @brief several tasks sharing the bus and the module
+//!
+//! Without bus lock the response to one task's command is read by another task
+//!
+void test_ConcurrentTasks(void) {
+    std::vector<std::thread> tasks;
+    std::atomic<int>         errors(0);
+
+    encoder.setPosition(1234);
+    module.setButtonPin(LOW);
+
+    for (int task = 0; task < TASKS; task++) {
+        tasks.emplace_back([task, &errors]() {
+            EncoderI2C taskEncoder;
+
+            for (unsigned loop = 0; loop < ITERATIONS; loop++) {
+                switch (task) {
+                case 0:
+                    errors += taskEncoder.position() != 1234;
+                    break;
+
+                case 1:
+                    errors += taskEncoder.button() != true;
+                    break;
+
+                case 2:
+                    errors += taskEncoder.direction() != None;
+                    break;
+
+                default:
+                    errors += taskEncoder.version().length() == 0;
+                    break;
+                }
+            }
+        });
+    }
+
+    for (std::thread& task : tasks) {
+        task.join();
+    }
+
+    TEST_ASSERT_EQUAL(0, errors.load());
+    TEST_ASSERT_EQUAL(0, Wire.statistics().violations);
+}
+
+//!
+//! @brief background polling with lock free snapshots
+//!
+void test_Monitor(void) {
+    EncoderI2CMonitor monitor(encoder);
+
+    TEST_ASSERT_EQUAL(0, monitor.snapshot().count);
+
+    TEST_ASSERT_TRUE(monitor.start(0));
+    TEST_ASSERT_FALSE(monitor.start(0));
+
+    module.rotate(7);
+
+    // foreground task keeps using the bus
+    for (unsigned loop = 0; loop < ITERATIONS; loop++) {
+        encoder.button();
+    }
+
+    unsigned long count = monitor.snapshot().count;
+
+    while (monitor.snapshot().count < count + 2) {
+        std::this_thread::yield();
+    }
+
+    monitor.stop();
+
+    TEST_ASSERT_FALSE(monitor.running());
+    TEST_ASSERT_EQUAL(7, monitor.snapshot().position);
+
+    // polls from several tasks are serialized, none is lost
+    EncoderI2CMonitor shared(encoder);
+    std::thread       other([&shared]() {
+        for (unsigned loop = 0; loop < ITERATIONS; loop++) {
+            shared.poll();
+        }
+    });
+
+    for (unsigned loop = 0; loop < ITERATIONS; loop++) {
+        shared.poll();
+    }
+
+    other.join();
+
+    TEST_ASSERT_EQUAL(2 * ITERATIONS, shared.snapshot().count);
+    TEST_ASSERT_EQUAL(7, shared.snapshot().position);
+    TEST_ASSERT_EQUAL(0, Wire.statistics().violations);
+
+    // one poll is one Get_Status round trip
+    Wire.resetStatistics();
+    shared.poll();
+    TEST_ASSERT_EQUAL(ENCODER_I2C_FEATURE_STATUS ? 2 : 6, Wire.statistics().transactions);
+}
+
+//!
+//! @brief deferred error log
+//!
+void test_ErrorLog(void) {
+#if ENCODER_I2C_ERROR_LOG_SIZE == 0
+    TEST_IGNORE_MESSAGE("error log stripped");
+#else
+    EncoderI2C        absent(0x30);
+    EncoderI2CError_t error;
+    char              text[80];
+
+    EncoderI2CErrors.clear();
+
+    absent.position();
+
+    TEST_ASSERT_EQUAL(1, EncoderI2CErrors.count());
+    TEST_ASSERT_TRUE(EncoderI2CErrors.pop(error));
+    TEST_ASSERT_EQUAL(Error_Missing, error.kind);
+    TEST_ASSERT_EQUAL(0x30, error.address);
+    TEST_ASSERT_EQUAL(Get_Position, error.command);
+    TEST_ASSERT_EQUAL(sizeof(EncoderI2CPosition_t), error.expected);
+    TEST_ASSERT_EQUAL(0, error.received);
+    TEST_ASSERT_GREATER_THAN(0, EncoderI2CErrorLog::format(error, text, sizeof(text)));
+    TEST_ASSERT_FALSE(EncoderI2CErrors.pop(error));
+
+    // oldest entries are overwritten
+    for (unsigned loop = 0; loop < ENCODER_I2C_ERROR_LOG_SIZE + 2; loop++) {
+        absent.button();
+    }
+
+    TEST_ASSERT_EQUAL(ENCODER_I2C_ERROR_LOG_SIZE, EncoderI2CErrors.count());
+    TEST_ASSERT_EQUAL(2, EncoderI2CErrors.dropped());
+
+    // tasks log and drain at the same time, every entry is either popped or dropped
+    EncoderI2CErrors.clear();
+
+    unsigned    popped = 0;
+    std::thread logger([]() {
+        for (unsigned loop = 0; loop < ITERATIONS; loop++) {
+            EncoderI2CErrors.log(Error_Missing, 0x30, Get_Position, sizeof(EncoderI2CPosition_t), 0);
+        }
+    });
+
+    for (unsigned loop = 0; loop < ITERATIONS; loop++) {
+        popped += EncoderI2CErrors.pop(error) ? 1 : 0;
+    }
+
+    logger.join();
+
+    while (EncoderI2CErrors.pop(error)) {
+        TEST_ASSERT_EQUAL(Get_Position, error.command);
+        popped++;
+    }
+
+    TEST_ASSERT_EQUAL(ITERATIONS, popped + EncoderI2CErrors.dropped());
+
+    // the bus to the module is fine
+    EncoderI2CErrors.clear();
+    encoder.position();
+
+    TEST_ASSERT_EQUAL(0, EncoderI2CErrors.count());
+#endif
+}
+
+//!
+//! @brief pipelined polling of several modules
+//!
+void test_PollAll(void) {
+    EncoderI2CSim*      modules[TASKS];
+    EncoderI2C          encoders[TASKS];
+    EncoderI2C*         pointers[TASKS];
+    EncoderI2CReading_t results[TASKS];
+
+    Wire.detachAll();
+
+    for (int loop = 0; loop < TASKS; loop++) {
+        modules[loop] = new EncoderI2CSim(0x20 + loop);
+        modules[loop]->rotate(loop - 1);
+        modules[loop]->setButtonPin(loop % 2);
+        Wire.attach(modules[loop]);
+
+        encoders[loop] = EncoderI2C(0x20 + loop);
+        pointers[loop] = &encoders[loop];
+    }
+
+    // sequential polling
+    unsigned long sequential = nativeDelayMicros;
+
+    for (int loop = 0; loop < TASKS; loop++) {
+        encoders[loop].position();
+        encoders[loop].direction();
+        encoders[loop].button();
+    }
+
+    sequential = nativeDelayMicros - sequential;
+
+    // pipelined polling
+    for (int loop = 0; loop < TASKS; loop++) {
+        modules[loop]->rotate(loop - 1);
+    }
+
+    unsigned long pipelined = nativeDelayMicros;
+
+    EncoderI2C::pollAll(pointers, TASKS, results);
+
+    pipelined = nativeDelayMicros - pipelined;
+
+    for (int loop = 0; loop < TASKS; loop++) {
+        TEST_ASSERT_EQUAL(2 * (loop - 1), results[loop].position);
+        TEST_ASSERT_EQUAL(loop < 1 ? Backward : loop > 1 ? Forward : None, results[loop].direction);
+        TEST_ASSERT_EQUAL(loop % 2 == 0, results[loop].button);
+    }
+
+    // Get_Status replaces the three commands of a module
+    const unsigned long commands = ENCODER_I2C_FEATURE_STATUS ? 1 : 3;
+
+    TEST_ASSERT_EQUAL(sequential * commands, 3 * pipelined * TASKS);
+
+    // the readings of one module at once
+    modules[0]->rotate(1);
+    Wire.resetStatistics();
+
+    EncoderI2CReading_t single = encoders[0].reading();
+
+    TEST_ASSERT_EQUAL(-1, single.position);
+    TEST_ASSERT_EQUAL(Forward, single.direction);
+    TEST_ASSERT_TRUE(single.button);
+    TEST_ASSERT_EQUAL(2 * commands, Wire.statistics().transactions);
+
+    Wire.detachAll();
+
+    for (int loop = 0; loop < TASKS; loop++) {
+        delete modules[loop];
+    }
+}
+
+//!
+//! @brief adaptive polling
+//!
+void test_Poller(void) {
+    EncoderI2CSim    idleModule(0x11);
+    EncoderI2C       idleEncoder(0x11);
+    EncoderI2CPoller poller(20, 640);
+
+    Wire.attach(&idleModule);
+
+    poller.setDecay(200);
+    TEST_ASSERT_TRUE(poller.add(encoder));
+    TEST_ASSERT_TRUE(poller.add(idleEncoder));
+
+    // first update polls all encoders
+    TEST_ASSERT_EQUAL(0, poller.update());
+    TEST_ASSERT_EQUAL(40, poller.interval(0));
+    TEST_ASSERT_EQUAL(40, poller.interval(1));
+
+    // idle encoders back off to the idle interval
+    for (unsigned loop = 0; loop < 10; loop++) {
+        delay(poller.interval(0));
+        poller.update();
+    }
+
+    TEST_ASSERT_EQUAL(640, poller.interval(0));
+    TEST_ASSERT_EQUAL(640, poller.interval(1));
+
+    // a change switches to the fast interval
+    module.rotate(1);
+    delay(640);
+
+    TEST_ASSERT_EQUAL(1, poller.update());
+    TEST_ASSERT_TRUE(poller.changed(0));
+    TEST_ASSERT_FALSE(poller.changed(1));
+    TEST_ASSERT_EQUAL(20, poller.interval(0));
+    TEST_ASSERT_EQUAL(1, poller.reading(0).position);
+    TEST_ASSERT_EQUAL(Forward, poller.reading(0).direction);
+
+    // the bus budget goes to the active encoder
+    unsigned long activeCommands = module.transmissions();
+    unsigned long idleCommands   = idleModule.transmissions();
+
+    poller.setBudget(1);
+
+    for (unsigned loop = 0; loop < 100; loop++) {
+        module.rotate(1);
+        delay(20);
+        poller.update();
+    }
+
+    activeCommands = module.transmissions() - activeCommands;
+    idleCommands   = idleModule.transmissions() - idleCommands;
+
+    TEST_ASSERT_GREATER_THAN(5 * idleCommands, activeCommands);
+    TEST_ASSERT_GREATER_THAN(0, idleCommands);
+}
+
+//!
+//! @brief worst case time of the command handlers
+//!
+//! The minimum of several rounds filters out preemption of the test process
+//!
+void test_DispatcherTime(void) {
+    EncoderI2CDispatcher<EncoderI2CSim> dispatcher(module);
+    std::chrono::nanoseconds            worst = std::chrono::nanoseconds::max();
+
+    for (unsigned round = 0; round < 5; round++) {
+        std::chrono::nanoseconds roundWorst(0);
+
+        for (const EncoderI2CCommandInfo_t& info : EncoderI2CCommandTable) {
+            if (!commandEnabled(info.command)) {
+                continue;
+            }
+
+            byte data[1 + EncoderI2CMaxRequest] = {info.command};
+            byte response[EncoderI2CMaxResponse];
+
+            if (info.command == Get_Bulk) {
+                // the largest chunk
+                EncoderI2CBulkRequest_t request = {Bulk_Version, 0, ENCODER_I2C_BULK_CHUNK};
+
+                memcpy(data + 1, &request, sizeof(request));
+            }
+
+            for (unsigned loop = 0; loop < ITERATIONS; loop++) {
+                auto start = std::chrono::steady_clock::now();
+
+                dispatcher.receive(data, 1 + info.request);
+                TEST_ASSERT_EQUAL(info.response, dispatcher.respond(response, sizeof(response)));
+
+                roundWorst = std::max<std::chrono::nanoseconds>(roundWorst, std::chrono::steady_clock::now() - start);
+            }
+        }
+
+        worst = std::min(worst, roundWorst);
+    }
+
+    TEST_ASSERT_LESS_THAN(HANDLER_BUDGET, worst.count());
+}
+
+//!
+//! @brief compile time feature selection of the dispatcher
+//!
+void test_Features(void) {
+    EncoderI2CDispatcher<EncoderI2CSim, Feature_Base> dispatcher(module);
+    EncoderI2CPosition_t                              value = 5;
+    byte                                              response[sizeof(EncoderI2CVersion_t)];
+    byte                                              command[1 + sizeof(value)];
+
+    TEST_ASSERT_TRUE(commandEnabled(Get_Position, Feature_Base));
+    TEST_ASSERT_FALSE(commandEnabled(Get_Version, Feature_Base));
+    TEST_ASSERT_TRUE(commandEnabled(Get_Version, Feature_Version));
+    TEST_ASSERT_EQUAL(sizeof(EncoderI2CVersion_t), maxResponseSize(Feature_Version));
+    TEST_ASSERT_LESS_THAN(sizeof(EncoderI2CVersion_t), maxResponseSize(Feature_Base));
+
+    // disabled commands are ignored
+    command[0] = Get_Version;
+    dispatcher.receive(command, 1);
+    TEST_ASSERT_EQUAL(0, dispatcher.respond(response, sizeof(response)));
+
+    command[0] = Set_LowerLimit;
+    memcpy(command + 1, &value, sizeof(value));
+    dispatcher.receive(command, sizeof(command));
+    TEST_ASSERT_EQUAL(0, dispatcher.sequence());
+
+    // base commands are available
+    command[0] = Set_Position;
+    dispatcher.receive(command, sizeof(command));
+    TEST_ASSERT_EQUAL(1, dispatcher.sequence());
+    TEST_ASSERT_EQUAL(5, module.position());
+
+    // the payload of a disabled command, sent separately, is never taken for a command
+    const EncoderI2CCommands_t disabled[] = {Set_LowerLimit, Set_UpperLimit, Set_Config, Set_Watch};
+    byte                       payload[ENCODER_I2C_BUFFER_SIZE];
+
+    memset(payload, Reset_Module, sizeof(payload));
+
+    for (EncoderI2CCommands_t cmd : disabled) {
+        dispatcher.receive(&cmd, 1);
+        dispatcher.receive(payload, EncoderI2CCommandTable[commandIndex(cmd)].request);
+
+        TEST_ASSERT_EQUAL(1, dispatcher.sequence());
+        TEST_ASSERT_EQUAL(5, module.position());
+    }
+
+    // the next transmission is a command again
+    command[0] = Get_Position;
+    dispatcher.receive(command, 1);
+    TEST_ASSERT_EQUAL(sizeof(value), dispatcher.respond(response, sizeof(response)));
+    TEST_ASSERT_EQUAL_MEMORY(&value, response, sizeof(value));
+}
+
+//!
+//! @brief reads within the cache age are served without bus traffic
+//!
+void test_Cache(void) {
+    EncoderI2CReading_t reading;
+
+    // transactions of one refresh
+    const unsigned long fetch = ENCODER_I2C_FEATURE_STATUS ? 2 : 6;
+
+    // longer than one refresh including its command delays
+    const unsigned long age = 100000;
+
+    encoder.setCacheAge(age);
+    module.rotate(2);
+    Wire.resetStatistics();
+
+    // one refresh serves all readings
+    TEST_ASSERT_EQUAL(2, encoder.position());
+    TEST_ASSERT_EQUAL(Forward, encoder.direction());
+    TEST_ASSERT_TRUE(encoder.button() == module.button());
+    TEST_ASSERT_EQUAL(2, encoder.position());
+    TEST_ASSERT_EQUAL(fetch, Wire.statistics().transactions);
+
+    // the direction is served once
+    TEST_ASSERT_EQUAL(None, encoder.direction());
+
+    // stale readings are refreshed
+    module.rotate(-3);
+    TEST_ASSERT_EQUAL(2, encoder.position());
+
+    delayMicroseconds(age + 1);
+    TEST_ASSERT_EQUAL(-1, encoder.position());
+    TEST_ASSERT_EQUAL(2 * fetch, Wire.statistics().transactions);
+
+    // a direction fetched by position() is kept for direction()
+    TEST_ASSERT_EQUAL(Backward, encoder.direction());
+
+    // the age is counted from the request, the served readings are never older than the cache age
+    unsigned long requested = micros();
+
+    encoder.invalidate();
+    TEST_ASSERT_EQUAL(-1, encoder.position());
+    TEST_ASSERT_GREATER_THAN(0, micros() - requested);
+
+    module.rotate(1);
+    delayMicroseconds(age + 1 - (micros() - requested));
+    TEST_ASSERT_EQUAL(0, encoder.position());
+    module.rotate(-1);
+
+    // writes and invalidate() force a refresh
+    encoder.setPosition(7);
+    TEST_ASSERT_EQUAL(7, encoder.position());
+
+    module.rotate(1);
+    encoder.invalidate();
+    TEST_ASSERT_EQUAL(8, encoder.position());
+
+    module.rotate(1);
+    reading = encoder.refresh();
+    TEST_ASSERT_EQUAL(9, reading.position);
+    TEST_ASSERT_EQUAL(Forward, reading.direction);
+
+    // disabled cache
+    encoder.setCacheAge(0);
+    Wire.resetStatistics();
+    TEST_ASSERT_EQUAL(9, encoder.position());
+    TEST_ASSERT_EQUAL(9, encoder.position());
+    TEST_ASSERT_EQUAL(4, Wire.statistics().transactions);
+}
+
+//!
+//! @brief chunked read of blocks larger than the Wire buffer
+//!
+void test_Bulk(void) {
+#if !ENCODER_I2C_FEATURE_BULK
+    TEST_IGNORE_MESSAGE("bulk transfer not selected");
+#else
+    byte          block[100];
+    byte          data[128];
+    size_t        count;
+    unsigned long delayed = nativeDelayMicros;
+
+    for (unsigned loop = 0; loop < sizeof(block); loop++) {
+        block[loop] = loop * 7;
+    }
+
+    module.setBlock(block, sizeof(block));
+    Wire.resetStatistics();
+
+    // maximal chunks, no command delays
+    TEST_ASSERT_TRUE(encoder.readBulk(Bulk_User, data, sizeof(data), count));
+    TEST_ASSERT_EQUAL(sizeof(block), count);
+    TEST_ASSERT_EQUAL_MEMORY(block, data, sizeof(block));
+    TEST_ASSERT_EQUAL(2 * ((sizeof(block) + ENCODER_I2C_BULK_CHUNK - 1) / ENCODER_I2C_BULK_CHUNK),
+                      Wire.statistics().transactions);
+    TEST_ASSERT_EQUAL(delayed, nativeDelayMicros);
+
+    // the version is not limited to EncoderI2CVersion_t
+    TEST_ASSERT_TRUE(encoder.readBulk(Bulk_Version, data, sizeof(data), count));
+    TEST_ASSERT_EQUAL_STRING(EncoderI2CSim::VERSION, (char*)data);
+
+    // small buffer, continue at an offset
+    TEST_ASSERT_FALSE(encoder.readBulk(Bulk_User, data, 50, count));
+    TEST_ASSERT_EQUAL(50, count);
+    TEST_ASSERT_TRUE(encoder.readBulk(Bulk_User, data + 50, sizeof(data) - 50, count, 50));
+    TEST_ASSERT_EQUAL(50, count);
+    TEST_ASSERT_EQUAL_MEMORY(block, data, sizeof(block));
+
+    // NACKs are retried
+    memset(data, 0, sizeof(data));
+    module.nack(EncoderI2C::BULK_RETRIES);
+    TEST_ASSERT_TRUE(encoder.readBulk(Bulk_User, data, sizeof(data), count));
+    TEST_ASSERT_EQUAL(sizeof(block), count);
+    TEST_ASSERT_EQUAL_MEMORY(block, data, sizeof(block));
+
+    // the transfer resumes after a persistent NACK
+    EncoderI2CErrors.clear();
+    memset(data, 0, sizeof(data));
+
+    TEST_ASSERT_FALSE(encoder.readBulk(Bulk_User, data, ENCODER_I2C_BULK_CHUNK, count));
+    TEST_ASSERT_EQUAL(ENCODER_I2C_BULK_CHUNK, count);
+    module.nack(EncoderI2C::BULK_RETRIES + 1);
+    TEST_ASSERT_FALSE(encoder.readBulk(Bulk_User, data, sizeof(data), count, ENCODER_I2C_BULK_CHUNK));
+    TEST_ASSERT_EQUAL(0, count);
+#if ENCODER_I2C_ERROR_LOG_SIZE > 0
+    TEST_ASSERT_GREATER_THAN(0, EncoderI2CErrors.count());
+#endif
+    TEST_ASSERT_TRUE(encoder.readBulk(Bulk_User, data + ENCODER_I2C_BULK_CHUNK, sizeof(data) - ENCODER_I2C_BULK_CHUNK,
+                                      count, ENCODER_I2C_BULK_CHUNK));
+    TEST_ASSERT_EQUAL(sizeof(block) - ENCODER_I2C_BULK_CHUNK, count);
+    TEST_ASSERT_EQUAL_MEMORY(block, data, sizeof(block));
+
+    // end of data at a chunk boundary and beyond the block
+    module.setBlock(block, 2 * ENCODER_I2C_BULK_CHUNK);
+    TEST_ASSERT_TRUE(encoder.readBulk(Bulk_User, data, sizeof(data), count));
+    TEST_ASSERT_EQUAL(2 * ENCODER_I2C_BULK_CHUNK, count);
+    TEST_ASSERT_TRUE(encoder.readBulk(Bulk_User, data, sizeof(data), count, 200));
+    TEST_ASSERT_EQUAL(0, count);
+
+    // an empty chunk without end of data is a framing error and does not hang
+    EncoderI2CErrors.clear();
+    Wire.resetStatistics();
+
+    TEST_ASSERT_FALSE(encoder.readBulk(EncoderI2CSim::STALLED_BLOCK, data, sizeof(data), count));
+    TEST_ASSERT_EQUAL(0, count);
+    TEST_ASSERT_EQUAL(2 * (EncoderI2C::BULK_RETRIES + 1), Wire.statistics().transactions);
+
+#if ENCODER_I2C_ERROR_LOG_SIZE > 0
+    EncoderI2CError_t error;
+
+    TEST_ASSERT_TRUE(EncoderI2CErrors.pop(error));
+    TEST_ASSERT_EQUAL(Error_Framing, error.kind);
+#endif
+#endif
+}
+
+//!
+//! @brief watch windows evaluated by the module
+//!
+void test_Watch(void) {
+#if !ENCODER_I2C_FEATURE_WATCH
+    TEST_IGNORE_MESSAGE("watch windows not selected");
+#else
+    TEST_ASSERT_TRUE(encoder.waitForWrite(encoder.setWatch(0, -10, 10)));
+    TEST_ASSERT_EQUAL(0, encoder.readWatchFlags());
+
+    // moving within the window
+    module.rotate(5);
+    TEST_ASSERT_EQUAL(0, encoder.readWatchFlags());
+
+    // leaving the window latches its flag until read
+    module.rotate(10);
+    module.rotate(1);
+    TEST_ASSERT_EQUAL(0x01, encoder.readWatchFlags());
+    TEST_ASSERT_EQUAL(0, encoder.readWatchFlags());
+
+    // entering a window
+    TEST_ASSERT_TRUE(encoder.waitForWrite(encoder.setWatch(1, 100, 200)));
+    module.rotate(100);
+    TEST_ASSERT_EQUAL(0x02, encoder.readWatchFlags());
+
+    // disabled windows are ignored
+    TEST_ASSERT_TRUE(encoder.waitForWrite(encoder.setWatch(0, 1, 0)));
+    encoder.setPosition(0);
+    TEST_ASSERT_EQUAL(0x02, encoder.readWatchFlags());
+
+    // windows out of range are ignored
+    encoder.setWatch(ENCODER_I2C_WATCH_COUNT, -10, 10);
+    TEST_ASSERT_EQUAL(0, encoder.readWatchFlags());
+
+    // ready line
+    EncoderI2CWatchWindows windows(5);
+    EncoderI2CWatch_t      watch = {0, 0, 10};
+
+    windows.set(watch, 0);
+    TEST_ASSERT_EQUAL(HIGH, digitalRead(5));
+    TEST_ASSERT_EQUAL(0, windows.update(5));
+    TEST_ASSERT_EQUAL(0x01, windows.update(11));
+    TEST_ASSERT_EQUAL(LOW, digitalRead(5));
+    TEST_ASSERT_EQUAL(0x01, windows.read());
+    TEST_ASSERT_EQUAL(HIGH, digitalRead(5));
+#endif
+}
+
+//!
+//! @brief quadrature signals at increasing rates, with bursts, reversals and bounce
+//!
+void test_Stress(void) {
+    EncoderI2CStress          stress(ENCA_PIN, ENCB_PIN);
+    EncoderI2CStressProfile_t profile = EncoderI2CStress::DEFAULT_PROFILE;
+    EncoderI2CStressResult_t  result;
+    char                      message[80];
+
+    stress.begin();
+    module.connect(ENCA_PIN, ENCB_PIN);
+
+    // slow rates are counted exactly
+    result = stress.measure(encoder, profile, 100);
+    TEST_ASSERT_EQUAL(0, result.lost);
+    TEST_ASSERT_EQUAL(result.expected, result.counted);
+
+    // bursts in one direction
+    profile.reverse = false;
+    result          = stress.measure(encoder, profile, 1000);
+    TEST_ASSERT_EQUAL(profile.bursts * profile.steps, result.expected);
+    TEST_ASSERT_EQUAL(0, result.lost);
+
+    // steps faster than the sample period of the module are lost
+    result = stress.measure(encoder, profile, 2 * 1000000 / EncoderI2CSim::SAMPLE_PERIOD);
+    TEST_ASSERT_GREATER_THAN(0, result.lost);
+
+    // highest rate without lost steps
+    unsigned rate = stress.maxRate(encoder, EncoderI2CStress::DEFAULT_PROFILE, 50, 50000);
+
+    snprintf(message, sizeof(message), "highest rate without lost steps: %u steps/s", rate);
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_GREATER_OR_EQUAL(1000, rate);
+    TEST_ASSERT_LESS_OR_EQUAL(1000000 / EncoderI2CSim::SAMPLE_PERIOD, rate);
+
+    // the start rate is clamped to 1..limitRate
+    TEST_ASSERT_EQUAL(100, stress.maxRate(encoder, EncoderI2CStress::DEFAULT_PROFILE, 0, 100));
+    TEST_ASSERT_EQUAL(200, stress.maxRate(encoder, EncoderI2CStress::DEFAULT_PROFILE, 500, 200));
+
+    module.disconnect();
+}
+
+//!
+//! @brief record a session against the module and replay it without the module
+//!
+void test_Trace(void) {
+#if !ENCODER_I2C_FEATURE_TRACE
+    TEST_IGNORE_MESSAGE("trace not selected");
+#else
+    EncoderI2CTraceRecord_t record;
+    EncoderI2C              absent(0x30);
+    EncoderI2CPosition_t    position;
+    EncoderI2CDirection_t   direction;
+    boolean                 button;
+
+    trace.clear();
+    while (EncoderI2CTrace.pop(record)) {
+    }
+
+    // record
+    EncoderI2CTrace.start(traceSink);
+
+    encoder.reset();
+    module.rotate(3);
+    direction = encoder.direction();
+    position  = encoder.position();
+    delay(5); // the application is busy between two transactions
+    encoder.setPosition(42);
+    button = encoder.button();
+    absent.position();
+
+    EncoderI2CTrace.stop();
+
+    // the ring holds the same records as the sink
+    for (unsigned loop = 0; loop < 2; loop++) {
+        TEST_ASSERT_TRUE(EncoderI2CTrace.pop(record));
+        TEST_ASSERT_EQUAL(Reset_Module, record.data[0]);
+    }
+
+    TEST_ASSERT_TRUE(EncoderI2CTrace.pop(record));
+    TEST_ASSERT_EQUAL(Trace_Write, record.direction);
+    TEST_ASSERT_EQUAL(ENCODER_I2C_ADDRESS, record.address);
+    TEST_ASSERT_EQUAL(0, record.result);
+    TEST_ASSERT_EQUAL(1, record.count);
+    TEST_ASSERT_EQUAL(Get_Direction, record.data[0]);
+
+    TEST_ASSERT_TRUE(EncoderI2CTrace.pop(record));
+    TEST_ASSERT_EQUAL(Trace_Read, record.direction);
+    TEST_ASSERT_EQUAL(sizeof(direction), record.result);
+    TEST_ASSERT_EQUAL(sizeof(direction), record.count);
+    TEST_ASSERT_EQUAL(Forward, record.data[0]);
+
+    // replay
+    EncoderI2CReplay replay;
+    EncoderI2CReplay replayAbsent(0x30);
+
+    TEST_ASSERT_GREATER_THAN(0, replay.load(trace.data(), trace.size()));
+    TEST_ASSERT_EQUAL(2, replayAbsent.load(trace.data(), trace.size()));
+
+    Wire.detachAll();
+    Wire.attach(&replay);
+    Wire.attach(&replayAbsent);
+
+    // same state of the host as during the recording
+    encoder = EncoderI2C();
+    encoder.reset();
+
+    TEST_ASSERT_EQUAL(direction, encoder.direction());
+    TEST_ASSERT_EQUAL(position, encoder.position());
+    encoder.setPosition(42);
+    TEST_ASSERT_EQUAL(button, encoder.button());
+    TEST_ASSERT_EQUAL(0, absent.position());
+
+    TEST_ASSERT_EQUAL(2, Wire.statistics().nacks);
+    TEST_ASSERT_EQUAL(0, replay.remaining());
+    TEST_ASSERT_EQUAL(0, replay.mismatches());
+    TEST_ASSERT_EQUAL(0, replayAbsent.remaining());
+    TEST_ASSERT_GREATER_OR_EQUAL(5000, replay.recordedTime());
+
+    // the simulated time follows the recording
+    TEST_ASSERT_EQUAL(replay.recordedTime(), replay.replayedTime());
+    TEST_ASSERT_EQUAL(0, replay.lag());
+
+    // deviations from the recording are detected
+    replay.clear();
+    replay.load(trace.data(), trace.size());
+
+    encoder = EncoderI2C();
+    encoder.reset();
+    encoder.direction();
+    delay(20);
+    encoder.position();
+    TEST_ASSERT_EQUAL(0, replay.mismatches());
+    TEST_ASSERT_GREATER_OR_EQUAL(20000, replay.lag());
+
+    encoder.button();
+    TEST_ASSERT_GREATER_THAN(0, replay.mismatches());
+
+    // the ring drops the oldest records
+    EncoderI2CTrace.start();
+
+    for (unsigned loop = 0; loop < ENCODER_I2C_TRACE_SIZE; loop++) {
+        encoder.button();
+    }
+
+    EncoderI2CTrace.stop();
+
+    TEST_ASSERT_GREATER_THAN(0, EncoderI2CTrace.dropped());
+    TEST_ASSERT_TRUE(EncoderI2CTrace.pop(record));
+#endif
+}
+
+//!
+//! @brief Main routine
+//!
+int main(int, char**) {
+    // start unit testing
+    UNITY_BEGIN();
+
+    RUN_TEST(test_Protocol);
+    RUN_TEST(test_WriteSequence);
+    RUN_TEST(test_LegacyFirmware);
+    RUN_TEST(test_SharedSequence);
+    RUN_TEST(test_ConcurrentTasks);
+    RUN_TEST(test_Monitor);
+    RUN_TEST(test_ErrorLog);
+    RUN_TEST(test_PollAll);
+    RUN_TEST(test_Poller);
+    RUN_TEST(test_DispatcherTime);
+    RUN_TEST(test_Features);
+    RUN_TEST(test_Cache);
+    RUN_TEST(test_Watch);
+    RUN_TEST(test_Bulk);
+    RUN_TEST(test_Stress);
+    RUN_TEST(test_Trace);
+
+    // stop unit testing
+    return UNITY_END();
+}
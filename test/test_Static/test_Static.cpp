@@ -85,9 +85,6 @@ void test_SetPosition(void) {
 
     encoder.setPosition(10);
 
-    // give encoder module time to digest command
-    delay(500);
-
     TEST_ASSERT_EQUAL(10, encoder.position());
     TEST_ASSERT_EQUAL(None, encoder.direction());
 }
@@ -122,9 +119,6 @@ void test_SetUpperLimit(void) {
 void test_SetLowerLimit(void) {
     encoder.setPosition(-50);
 
-    // give encoder module time to digest command
-    delay(500);
-
     TEST_ASSERT_EQUAL(-50, encoder.position());
 
     encoder.setLowerLimit(-40);
@@ -156,6 +150,26 @@ void test_SetAddress(void) {
     TEST_ASSERT_EQUAL(-40, encoder.position());
 }
 
+//!
+//! @brief test write acknowledgement
+//!
+void test_WriteSequence(void) {
+    TEST_ASSERT_EQUAL(-40, encoder.position());
+
+    // single write
+    EncoderI2CSequence_t token = encoder.setUpperLimit(40);
+
+    TEST_ASSERT_TRUE(encoder.waitForWrite(token));
+    TEST_ASSERT_TRUE(sequenceReached(encoder.sequence(), token));
+
+    // batch of writes
+    encoder.setLowerLimit(-40);
+    encoder.setUpperLimit(40);
+
+    TEST_ASSERT_TRUE(encoder.waitForWrites());
+    TEST_ASSERT_EQUAL(-40, encoder.position());
+}
+
 //!
 //! @brief Setup routine
 //!
@@ -180,6 +194,7 @@ void setup() {
     RUN_TEST(test_SetUpperLimit);
     RUN_TEST(test_SetLowerLimit);
     RUN_TEST(test_SetAddress);
+    RUN_TEST(test_WriteSequence);
 
     // stop unit testing
     UNITY_END();